@@ -9,8 +9,287 @@
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QJsonArray>
+#include <QtEndian>
+#include <QMediaPlayer>
+#include <QVideoWidget>
+
+#include <zlib.h>
+#include <zstd.h>
+#include <zdict.h>
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef Q_OS_UNIX
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#ifdef Q_OS_LINUX
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#endif
+#ifdef Q_OS_MACOS
+#include <sys/clonefile.h>
+#endif
+#ifdef ZIPPY_HAVE_LIBURING
+#include <liburing.h>
+#endif
+#include <algorithm>
+#include <cmath>
+#include <functional>
+
+// --- Background work helpers ---
+// shared cancellation flag: every copy observes the same state
+class CancelToken {
+public:
+    CancelToken() : m_flag(new QAtomicInt(0)) {}
+    void cancel() const { m_flag->storeRelease(1); }
+    bool isCancelled() const { return m_flag->loadAcquire() != 0; }
+    bool operator==(const CancelToken &o) const { return m_flag == o.m_flag; }
+private:
+    QSharedPointer<QAtomicInt> m_flag;
+};
+
+// QRunnable around a lambda (QRunnable::create only arrives in Qt 5.15)
+class FunctionRunnable : public QRunnable {
+public:
+    explicit FunctionRunnable(std::function<void()> fn) : m_fn(std::move(fn)) {}
+    void run() override { m_fn(); }
+private:
+    std::function<void()> m_fn;
+};
+
+// fn(i) for every i in [0, n) on a pool of its own, workers taking the next index as they free up
+static void parallelForEach(int n, const std::function<void(int)> &fn) {
+    const int threads = qMin(n, qMax(1, QThread::idealThreadCount()));
+    if (threads <= 1) {
+        for (int i = 0; i < n; ++i) fn(i);
+        return;
+    }
+    QThreadPool workers;
+    workers.setMaxThreadCount(threads);
+    QAtomicInt next(0);
+    for (int t = 0; t < threads; ++t) {
+        workers.start(new FunctionRunnable([&next, &fn, n]() {
+            for (int i = next.fetchAndAddRelaxed(1); i < n; i = next.fetchAndAddRelaxed(1)) fn(i);
+        }));
+    }
+    workers.waitForDone();
+}
+
+// --- Shared background job scheduler ---
+// every piece of archive work goes through one pool. Each class has its own
+// concurrency cap and the pool is sized to the sum of the caps, so bulk work can
+// never hold the thread an interactive preview needs; lower classes also run at
+// lower OS thread priority so they yield CPU to the interactive ones.
+enum class JobClass { InteractivePreview, Listing, BulkExtract, Background };
+
+class JobScheduler {
+public:
+    typedef std::function<void(const CancelToken &)> Job;
+
+    JobScheduler() {
+        m_limits[int(JobClass::InteractivePreview)] = 2;
+        m_limits[int(JobClass::Listing)] = 1;
+        m_limits[int(JobClass::BulkExtract)] = 1;
+        m_limits[int(JobClass::Background)] = 1;
+        updatePoolSize();
+    }
+
+    ~JobScheduler() {
+        {
+            QMutexLocker lock(&m_mutex);
+            m_shuttingDown = true;
+            for (int c = 0; c < kClassCount; ++c) {
+                for (const Pending &p : m_queues[c]) p.token.cancel();
+                for (const CancelToken &t : m_running[c]) t.cancel();
+                m_queues[c].clear();
+            }
+        }
+        m_pool.waitForDone();
+    }
+
+    // queue fn; the returned token cancels it whether it is still queued or already running
+    CancelToken submit(JobClass cls, Job fn) {
+        Pending p{std::move(fn), CancelToken()};
+        QMutexLocker lock(&m_mutex);
+        if (m_shuttingDown) { p.token.cancel(); return p.token; }
+        m_queues[int(cls)] << p;
+        dispatchLocked();
+        return p.token;
+    }
+
+    void cancelClass(JobClass cls) {
+        QMutexLocker lock(&m_mutex);
+        for (const Pending &p : m_queues[int(cls)]) p.token.cancel();
+        for (const CancelToken &t : m_running[int(cls)]) t.cancel();
+        m_queues[int(cls)].clear();
+    }
+
+    void setLimit(JobClass cls, int maxConcurrent) {
+        QMutexLocker lock(&m_mutex);
+        m_limits[int(cls)] = qMax(1, maxConcurrent);
+        updatePoolSize();
+        dispatchLocked();
+    }
+
+private:
+    static const int kClassCount = 4;
+    struct Pending { Job fn; CancelToken token; };
+
+    void updatePoolSize() {
+        int total = 0;
+        for (int c = 0; c < kClassCount; ++c) total += m_limits[c];
+        m_pool.setMaxThreadCount(total);
+    }
+
+    // start queued jobs, highest class first, as long as their class has a free slot
+    void dispatchLocked() {
+        static const QThread::Priority prio[kClassCount] = {
+            QThread::NormalPriority, QThread::NormalPriority, QThread::LowPriority, QThread::LowestPriority };
+        for (int c = 0; c < kClassCount; ++c) {
+            while (m_running[c].size() < m_limits[c] && !m_queues[c].isEmpty()) {
+                Pending p = m_queues[c].takeFirst();
+                if (p.token.isCancelled()) continue;
+                m_running[c] << p.token;
+                m_pool.start(new FunctionRunnable([this, c, p]() {
+                    QThread::currentThread()->setPriority(prio[c]);
+                    if (!p.token.isCancelled()) p.fn(p.token);
+                    QMutexLocker lock(&m_mutex);
+                    m_running[c].removeOne(p.token);
+                    if (!m_shuttingDown) dispatchLocked();
+                }), kClassCount - c);
+            }
+        }
+    }
+
+    QThreadPool m_pool;
+    QMutex m_mutex;
+    QList<Pending> m_queues[kClassCount];
+    QList<CancelToken> m_running[kClassCount];
+    int m_limits[kClassCount];
+    bool m_shuttingDown = false;
+};
+
+// --- Progress and cancellation for long operations ---
+struct ArchiveProgress {
+    qint64 bytesDone = 0;
+    qint64 bytesTotal = 0;      // 0 when unknown
+    int entriesDone = 0;
+    int entriesTotal = 0;
+    double bytesPerSecond = 0;
+    qint64 etaMs = -1;          // -1 while unknown
+    QString currentEntry;
+};
+Q_DECLARE_METATYPE(ArchiveProgress)
+
+// handed to one long backend call. The backend reports through begin/advance/finish
+// from whatever thread it runs on; progressChanged is throttled and reaches GUI
+// receivers queued. cancel() is safe from any thread: the call stops, cleans up
+// after itself and returns false.
+class ArchiveOperation : public QObject {
+    Q_OBJECT
+public:
+    explicit ArchiveOperation(QObject *parent = nullptr) : QObject(parent) {}
+
+    // also stop when this token fires, e.g. the scheduler job running the operation
+    void linkCancelToken(const CancelToken &token) { m_linked = token; }
+    bool isCancelled() const { return m_own.isCancelled() || m_linked.isCancelled(); }
+
+    ArchiveProgress progress() const {
+        QMutexLocker lock(&m_mutex);
+        return m_progress;
+    }
+
+    void begin(int entriesTotal, qint64 bytesTotal) {
+        QMutexLocker lock(&m_mutex);
+        m_progress = ArchiveProgress();
+        m_progress.entriesTotal = entriesTotal;
+        m_progress.bytesTotal = bytesTotal;
+        m_clock.start();
+        m_lastEmitMs = 0;
+        m_lastEmitBytes = 0;
+    }
+
+    void advance(qint64 bytes, int entries = 0, const QString &current = QString()) {
+        ArchiveProgress snapshot;
+        {
+            QMutexLocker lock(&m_mutex);
+            m_progress.bytesDone += bytes;
+            m_progress.entriesDone += entries;
+            if (!current.isEmpty()) m_progress.currentEntry = current;
+            const qint64 now = m_clock.elapsed();
+            if (now - m_lastEmitMs < kEmitIntervalMs) return;
+            updateRateLocked(now);
+            snapshot = m_progress;
+        }
+        emit progressChanged(snapshot);
+    }
+
+    void finish() {
+        ArchiveProgress snapshot;
+        {
+            QMutexLocker lock(&m_mutex);
+            updateRateLocked(m_clock.elapsed());
+            snapshot = m_progress;
+        }
+        emit progressChanged(snapshot);
+    }
+
+public slots:
+    void cancel() { m_own.cancel(); }
+
+signals:
+    void progressChanged(const ArchiveProgress &progress);
+
+private:
+    static const qint64 kEmitIntervalMs = 200;
+
+    void updateRateLocked(qint64 now) {
+        const qint64 dt = now - m_lastEmitMs;
+        if (dt > 0) {
+            const double instant = double(m_progress.bytesDone - m_lastEmitBytes) * 1000.0 / dt;
+            // smoothed so the ETA doesn't jump between runs of small and large entries
+            m_progress.bytesPerSecond = m_progress.bytesPerSecond > 0 ? 0.7 * m_progress.bytesPerSecond + 0.3 * instant : instant;
+        }
+        m_lastEmitMs = now;
+        m_lastEmitBytes = m_progress.bytesDone;
+        m_progress.etaMs = (m_progress.bytesTotal > 0 && m_progress.bytesPerSecond > 0)
+            ? qint64(qMax<qint64>(0, m_progress.bytesTotal - m_progress.bytesDone) * 1000.0 / m_progress.bytesPerSecond) : -1;
+    }
+
+    CancelToken m_own;
+    CancelToken m_linked;
+    mutable QMutex m_mutex;
+    ArchiveProgress m_progress;
+    QElapsedTimer m_clock;
+    qint64 m_lastEmitMs = 0;
+    qint64 m_lastEmitBytes = 0;
+};
 
 // --- ArchiveHandler base class ---
+// what an optimize pass did; bytes are the uncompressed payload it went through
+struct OptimizeResult {
+    qint64 sizeBefore = 0;
+    qint64 sizeAfter = 0;
+    qint64 bytes = 0;
+    qint64 elapsedMs = 0;
+    int recompressed = 0;   // entries that got smaller
+    int entries = 0;
+};
+
+// what an integrity test found; bytes are the uncompressed payload it checked
+struct TestResult {
+    QStringList corrupt;     // failed to decode, or crc or size disagree with the directory
+    QStringList unchecked;   // encrypted, or in a method the native reader lacks
+    int entries = 0;
+    qint64 bytes = 0;
+    qint64 elapsedMs = 0;
+};
+
 class ArchiveHandler : public QObject {
     Q_OBJECT
 public:
@@ -20,105 +299,5176 @@ public:
     virtual QString archivePath() const = 0;
     virtual QStringList listEntries(const QString &prefix = QString()) const = 0;
     virtual bool extractEntryToTemp(const QString &entry, QString &outPath) = 0;
-    virtual bool extractAll(const QString &destDir) = 0;
-    virtual bool addFiles(const QStringList &files, const QString &destPathInArchive) = 0;
-    virtual bool removeEntries(const QStringList &entries) = 0;
+    // long operations: op (optional) receives progress and can cancel; a cancelled call returns false
+    // and leaves no partially written file behind
+    virtual bool extractAll(const QString &destDir, ArchiveOperation *op = nullptr) = 0;
+    // extract a batch of entries (keeping their archive paths) in one pass instead of one call per entry
+    virtual bool extractEntries(const QStringList &entries, const QString &destDir, ArchiveOperation *op = nullptr) = 0;
+    virtual bool addFiles(const QStringList &files, const QString &destPathInArchive, ArchiveOperation *op = nullptr) = 0;
+    virtual bool removeEntries(const QStringList &entries, ArchiveOperation *op = nullptr) = 0;
     virtual void setPassword(const QString &pw) = 0;
+    // seekable read-only stream over one entry, owned by the caller; nullptr if the backend can't stream it
+    virtual QIODevice *openEntryDevice(const QString &entry) { Q_UNUSED(entry); return nullptr; }
+    // rewrite the archive in place, every entry compressed again at level (the backend's own scale)
+    // where that makes it smaller; the rewrite replaces the archive atomically once complete
+    virtual bool optimize(int level, OptimizeResult &result, ArchiveOperation *op = nullptr) {
+        Q_UNUSED(level); Q_UNUSED(result); Q_UNUSED(op);
+        return false;
+    }
+    // decode every entry to nowhere and check it against the directory; false if the test couldn't run
+    virtual bool testArchive(TestResult &result, ArchiveOperation *op = nullptr) {
+        Q_UNUSED(result); Q_UNUSED(op);
+        return false;
+    }
+    // copy entries as stored into a new archive of the same format at destPath; false if the backend can't
+    virtual bool exportEntries(const QStringList &entries, const QString &destPath, ArchiveOperation *op = nullptr) {
+        Q_UNUSED(entries); Q_UNUSED(destPath); Q_UNUSED(op);
+        return false;
+    }
+};
+
+// --- CLI fallback ArchiveHandler implementation ---
+class CliArchiveHandler : public ArchiveHandler {
+public:
+    CliArchiveHandler(QObject *parent = nullptr) : ArchiveHandler(parent) {}
+    ~CliArchiveHandler() override {}
+
+    bool openArchive(const QString &path) override {
+        m_archive = path;
+        return QFile::exists(path);
+    }
+    QString archivePath() const override { return m_archive; }
+
+    // note: returns entries optionally filtered by prefix
+    QStringList listEntries(const QString &prefix = QString()) const override {
+        QStringList entries;
+        QProcess p;
+        QStringList args;
+        args << "-Z" << "-1" << m_archive;
+        if (!m_password.isEmpty()) {
+            // unzip: -P password (note: insecure on CLI, but ok for demo)
+            args.prepend(m_password);
+            args.prepend("-P");
+        }
+        p.start("unzip", args);
+        p.waitForFinished(3000);
+
+        // if exit code non-zero and output empty, we may have a password issue
+        QByteArray out = p.readAllStandardOutput();
+        QByteArray err = p.readAllStandardError();
+        QTextStream ts(out);
+        while (!ts.atEnd()) {
+            QString line = ts.readLine().trimmed();
+            if (!line.isEmpty()) {
+                if (prefix.isEmpty() || line.startsWith(prefix)) entries << line;
+            }
+        }
+        return entries;
+    }
+
+    bool extractEntryToTemp(const QString &entry, QString &outPath) override {
+        QString persistentTmp = QDir::temp().filePath(QString("qt_arch_tmp_%1").arg(QUuid::createUuid().toString()));
+        QDir().mkpath(persistentTmp);
+        QProcess p;
+        QStringList args;
+        if (!m_password.isEmpty()) { args << "-P" << m_password; }
+        args << m_archive << entry << "-d" << persistentTmp;
+        p.start("unzip", args);
+        p.waitForFinished(-1);
+        if (p.exitCode() == 0) {
+            outPath = QDir(persistentTmp).filePath(entry);
+            return true;
+        }
+        return false;
+    }
+
+    bool extractAll(const QString &destDir, ArchiveOperation *op = nullptr) override {
+        if (op) {
+            qint64 bytes = 0;
+            int files = archiveTotals(bytes);
+            op->begin(files, bytes);
+        }
+        bool ok = runUnzip(QStringList(), destDir, op);
+        if (ok && op) op->finish();
+        return ok;
+    }
+
+    bool extractEntries(const QStringList &entries, const QString &destDir, ArchiveOperation *op = nullptr) override {
+        if (op) op->begin(entries.size(), 0);
+        // one unzip per batch rather than per entry; batching keeps the command line under ARG_MAX
+        static const int kBatch = 512;
+        for (int i = 0; i < entries.size(); i += kBatch) {
+            if (!runUnzip(entries.mid(i, kBatch), destDir, op)) return false;
+        }
+        if (op) op->finish();
+        return true;
+    }
+
+    bool addFiles(const QStringList &files, const QString &, ArchiveOperation *op = nullptr) override {
+        // zip archive.zip files...
+        QStringList args;
+        args << m_archive;
+        for (const QString &f : files) args << f;
+        if (op) {
+            qint64 bytes = 0;
+            for (const QString &f : files) bytes += QFileInfo(f).size();
+            op->begin(files.size(), bytes);
+        }
+        // zip reports one "adding:"/"updating:" line per input, in argument order
+        int next = 0;
+        const QStringList tempsBefore = zipTempFiles();
+        bool ok = runTool("zip", args, op, [&](const QString &line) {
+            if (!op || next >= files.size() || !(line.startsWith("adding:") || line.startsWith("updating:"))) return;
+            const QString &f = files.at(next++);
+            op->advance(QFileInfo(f).size(), 1, f);
+        });
+        return finishZipRewrite(ok, op, tempsBefore);
+    }
+
+    bool removeEntries(const QStringList &entries, ArchiveOperation *op = nullptr) override {
+        QStringList args;
+        args << m_archive;
+        for (const QString &e : entries) args << e;
+        if (op) op->begin(entries.size(), 0);
+        const QStringList tempsBefore = zipTempFiles();
+        bool ok = runTool("zip", QStringList{"-d"} + args, op, [&](const QString &line) {
+            if (op && line.startsWith("deleting:")) op->advance(0, 1, line.mid(9).trimmed());
+        });
+        return finishZipRewrite(ok, op, tempsBefore);
+    }
+
+    void setPassword(const QString &pw) override { m_password = pw; }
+
+protected:
+    // unzip the given entries (all when empty) into destDir, reporting each file to op
+    bool runUnzip(const QStringList &entries, const QString &destDir, ArchiveOperation *op) const {
+        QStringList args;
+        if (!m_password.isEmpty()) { args << "-P" << m_password; }
+        args << m_archive << entries << "-d" << destDir;
+        // unzip announces each file as it starts writing it, so the previous one is complete by then
+        QString current;
+        auto finishCurrent = [&]() {
+            if (op && !current.isEmpty()) op->advance(QFileInfo(current).size(), 1, current);
+            current.clear();
+        };
+        static const QRegularExpression fileLine("^(inflating|extracting|creating):\\s+(.+)$");
+        bool ok = runTool("unzip", args, op, [&](const QString &line) {
+            QRegularExpressionMatch m = fileLine.match(line);
+            if (!m.hasMatch()) return;
+            finishCurrent();
+            if (m.captured(1) == "creating") { if (op) op->advance(0, 1); }
+            else current = m.captured(2);
+        });
+        if (op && op->isCancelled()) {
+            // the file being written when unzip was killed is incomplete
+            if (!current.isEmpty()) QFile::remove(current);
+            return false;
+        }
+        finishCurrent();
+        return ok;
+    }
+
+    // runs a CLI tool and feeds each stdout line to onLine; kills it and returns false once op is cancelled
+    bool runTool(const QString &program, const QStringList &args, ArchiveOperation *op,
+                 const std::function<void(const QString &)> &onLine) const {
+        QProcess p;
+        p.start(program, args);
+        if (!p.waitForStarted(-1)) return false;
+        QByteArray pending;
+        auto drain = [&]() {
+            pending += p.readAllStandardOutput();
+            p.readAllStandardError();
+            int nl;
+            while ((nl = pending.indexOf('\n')) >= 0) {
+                const QString line = QString::fromLocal8Bit(pending.left(nl)).trimmed();
+                pending.remove(0, nl + 1);
+                if (!line.isEmpty() && onLine) onLine(line);
+            }
+        };
+        while (!p.waitForFinished(100)) {
+            drain();
+            if (op && op->isCancelled()) { p.kill(); p.waitForFinished(-1); return false; }
+            if (p.state() == QProcess::NotRunning) break;
+        }
+        drain();
+        return p.exitStatus() == QProcess::NormalExit && p.exitCode() == 0;
+    }
+
+    // entry count and uncompressed total from the "N files, X bytes uncompressed" summary of unzip -Zt
+    int archiveTotals(qint64 &bytes) const {
+        QProcess p;
+        p.start("unzip", {"-Zt", m_archive});
+        p.waitForFinished(3000);
+        static const QRegularExpression summary("(\\d+) files?, (\\d+) bytes uncompressed");
+        QRegularExpressionMatch m = summary.match(QString::fromLocal8Bit(p.readAllStandardOutput()));
+        bytes = m.hasMatch() ? m.captured(2).toLongLong() : 0;
+        return m.hasMatch() ? m.captured(1).toInt() : 0;
+    }
+
+    // zip rewrites into a "ziXXXXXX" temp next to the archive and renames it over the original at the end
+    QStringList zipTempFiles() const {
+        return QDir(QFileInfo(m_archive).absolutePath()).entryList({"zi??????"}, QDir::Files);
+    }
+
+    // a killed zip leaves the original archive untouched; only its temp file has to go
+    bool finishZipRewrite(bool ok, ArchiveOperation *op, const QStringList &tempsBefore) const {
+        if (op && op->isCancelled()) {
+            QDir dir(QFileInfo(m_archive).absolutePath());
+            for (const QString &t : zipTempFiles()) {
+                if (!tempsBefore.contains(t)) dir.remove(t);
+            }
+            return false;
+        }
+        if (op) op->finish();
+        return ok;
+    }
+
+private:
+    QString m_archive;
+    QString m_password;
+};
+
+// --- Native zip reading ---
+static const quint32 kZipLocalHeaderSig = 0x04034b50;
+static const quint32 kZipCentralHeaderSig = 0x02014b50;
+static const quint32 kZipEndOfCentralDirSig = 0x06054b50;
+static const int kZipLocalHeaderSize = 30;
+static const int kZipCentralHeaderSize = 46;
+static const int kZipEndOfCentralDirSize = 22;
+static const quint32 kZip64EndOfCentralDirSig = 0x06064b50;
+static const quint32 kZip64LocatorSig = 0x07064b50;
+static const int kZip64EndOfCentralDirSize = 56;
+static const int kZip64LocatorSize = 20;
+
+struct ZipEntryInfo {
+    QString name;
+    quint16 flags = 0;
+    quint16 method = 0;       // 0 = stored, 8 = deflate
+    quint32 crc = 0;
+    quint32 dosDateTime = 0;  // date << 16 | time
+    qint64 compressedSize = 0;
+    qint64 size = 0;
+    qint64 localHeaderOffset = 0;
+    qint64 centralHeaderOffset = 0;
+
+    bool isEncrypted() const { return flags & 0x1; }
+    bool isDir() const { return name.endsWith('/'); }
+    bool isNativelyReadable() const { return !isEncrypted() && (method == 0 || method == 8); }
+};
+
+// --- Split (multi-volume) zip sets ---
+// name.z01, name.z02, ..., name.zip read as one device: the volumes are laid end to end,
+// a (disk, offset) pair from the central directory becomes starts[disk] + offset, and a
+// virtual position is mapped back to its volume with a binary search over the starts
+class MultiVolumeDevice : public QIODevice {
+    Q_OBJECT
+public:
+    // the volumes of the split set ending in zipPath, in disk order; empty if it isn't one
+    static QStringList volumesFor(const QString &zipPath) {
+        const QFileInfo fi(zipPath);
+        if (fi.suffix().compare("zip", Qt::CaseInsensitive) != 0) return QStringList();
+        const QString base = fi.dir().filePath(fi.completeBaseName());
+        QStringList volumes;
+        for (int n = 1; ; ++n) {
+            const QString part = QString("%1.z%2").arg(base).arg(n, 2, 10, QChar('0'));
+            if (!QFileInfo::exists(part)) break;
+            volumes << part;
+        }
+        if (volumes.isEmpty()) return QStringList();
+        volumes << zipPath;
+        return volumes;
+    }
+
+    explicit MultiVolumeDevice(const QStringList &volumes, QObject *parent = nullptr)
+        : QIODevice(parent), m_paths(volumes) {
+        for (const QString &v : volumes) {
+            m_starts << m_size;
+            m_size += QFileInfo(v).size();
+        }
+    }
+
+    bool open(OpenMode mode) override {
+        if (mode & WriteOnly) return false;
+        m_pos = 0;
+        return QIODevice::open(mode | QIODevice::Unbuffered);
+    }
+    void close() override {
+        m_volume.close();
+        m_current = -1;
+        QIODevice::close();
+    }
+
+    bool isSequential() const override { return false; }
+    qint64 size() const override { return m_size; }
+    bool seek(qint64 pos) override {
+        if (pos < 0 || pos > m_size || !QIODevice::seek(pos)) return false;
+        m_pos = pos;
+        return true;
+    }
+
+    qint64 virtualOffset(int disk, qint64 offset) const {
+        return disk >= 0 && disk < m_starts.size() ? m_starts.at(disk) + offset : -1;
+    }
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override {
+        qint64 done = 0;
+        while (done < maxSize && m_pos < m_size) {
+            // the last volume starting at or before m_pos (empty volumes share a start with the next)
+            const int v = int(std::upper_bound(m_starts.constBegin(), m_starts.constEnd(), m_pos) - m_starts.constBegin()) - 1;
+            if (!openVolume(v) || !m_volume.seek(m_pos - m_starts.at(v))) break;
+            const qint64 volumeEnd = v + 1 < m_starts.size() ? m_starts.at(v + 1) : m_size;
+            const qint64 n = m_volume.read(data + done, qMin(maxSize - done, volumeEnd - m_pos));
+            if (n <= 0) break;
+            done += n;
+            m_pos += n;
+        }
+        return done > 0 || maxSize == 0 || m_pos >= m_size ? done : -1;
+    }
+    qint64 writeData(const char *, qint64) override { return -1; }
+
+private:
+    bool openVolume(int v) {
+        if (v == m_current) return true;
+        m_volume.close();
+        m_volume.setFileName(m_paths.at(v));
+        m_current = m_volume.open(QIODevice::ReadOnly) ? v : -1;
+        return m_current == v;
+    }
+
+    QStringList m_paths;
+    QVector<qint64> m_starts;
+    qint64 m_size = 0;
+    qint64 m_pos = 0;
+    QFile m_volume;   // only one volume is open at a time
+    int m_current = -1;
+};
+
+// the archive as one readable device: the file itself, or the concatenated volumes of a split set
+static QIODevice *openArchiveDevice(const QString &path, QIODevice::OpenMode mode = QIODevice::ReadOnly) {
+    const QStringList volumes = MultiVolumeDevice::volumesFor(path);
+    QIODevice *dev = volumes.isEmpty() ? static_cast<QIODevice*>(new QFile(path)) : new MultiVolumeDevice(volumes);
+    if (!dev->open(mode)) { delete dev; return nullptr; }
+    return dev;
+}
+
+// --- Memory-mapped archive access ---
+// maps the whole archive once on 64-bit builds; 32-bit builds (or files that can't be
+// mapped whole) use a sliding window so multi-GB archives don't exhaust the address space.
+// Falls back to reading the window when the file can't be mapped at all or is a split set.
+class ArchiveMap {
+public:
+    static const qint64 kWindow = 64 * 1024 * 1024;
+
+    explicit ArchiveMap(QIODevice &device)
+        : m_device(device), m_file(qobject_cast<QFile*>(&device)), m_size(device.size()) {}
+    ~ArchiveMap() { release(); }
+
+    qint64 size() const { return m_size; }
+
+    // len bytes at offset, nullptr past the end or on I/O error; valid until the next call
+    const char *at(qint64 offset, qint64 len) {
+        if (offset < 0 || len < 0 || offset + len > m_size) return nullptr;
+        if (!m_valid || offset < m_offset || offset + len > m_offset + m_length) {
+            release();
+            const bool whole = sizeof(void*) >= 8 || m_size <= kWindow;
+            m_offset = whole ? 0 : offset;
+            m_length = whole ? m_size : qMax(len, qMin(kWindow, m_size - offset));
+            m_base = m_file && m_length > 0 ? m_file->map(m_offset, m_length) : nullptr;
+            if (!m_base && m_length > 0) {
+                m_offset = offset;
+                m_length = qMax(len, qMin(kWindow, m_size - offset));
+                if (!m_device.seek(m_offset)) return nullptr;
+                m_buffer = m_device.read(m_length);
+                if (m_buffer.size() != m_length) { m_buffer.clear(); return nullptr; }
+            }
+            m_valid = true;
+        }
+        const char *base = m_base ? reinterpret_cast<const char*>(m_base) : m_buffer.constData();
+        return base + (offset - m_offset);
+    }
+
+private:
+    void release() {
+        if (m_base) m_file->unmap(m_base);
+        m_base = nullptr;
+        m_buffer.clear();
+        m_valid = false;
+    }
+
+    QIODevice &m_device;
+    QFile *m_file;   // null for devices that can't be mapped
+    const qint64 m_size;
+    uchar *m_base = nullptr;
+    QByteArray m_buffer;
+    qint64 m_offset = 0;
+    qint64 m_length = 0;
+    bool m_valid = false;
+};
+
+// parse the end-of-central-directory record (ZIP64 included) and every central header
+// straight out of the mapping; false if this isn't a zip we understand
+static bool readZipCentralDirectory(QIODevice &f, QVector<ZipEntryInfo> &out) {
+    out.clear();
+    ArchiveMap map(f);
+    // offsets in the directory are relative to the volume (disk) they point into
+    const MultiVolumeDevice *volumes = qobject_cast<const MultiVolumeDevice*>(&f);
+    auto toVirtual = [volumes](qint64 disk, qint64 offset) {
+        return volumes ? volumes->virtualOffset(int(disk), offset) : offset;
+    };
+    const qint64 fileSize = map.size();
+    if (fileSize < kZipEndOfCentralDirSize) return false;
+
+    // the EOCD sits in the last 22 bytes plus an optional comment of up to 64 KiB
+    const qint64 tailLen = qMin<qint64>(fileSize, kZipEndOfCentralDirSize + 0xFFFF);
+    const char *tail = map.at(fileSize - tailLen, tailLen);
+    if (!tail) return false;
+    qint64 eocd = -1;
+    for (qint64 i = tailLen - kZipEndOfCentralDirSize; i >= 0; --i) {
+        if (qFromLittleEndian<quint32>(tail + i) == kZipEndOfCentralDirSig) { eocd = i; break; }
+    }
+    if (eocd < 0) return false;
+    const char *e = tail + eocd;
+    const qint64 eocdOffset = fileSize - tailLen + eocd;
+    qint64 cdDisk = qFromLittleEndian<quint16>(e + 6);
+    qint64 totalEntries = qFromLittleEndian<quint16>(e + 10);
+    qint64 cdSize = qFromLittleEndian<quint32>(e + 12);
+    qint64 cdOffset = qFromLittleEndian<quint32>(e + 16);
+
+    // a saturated field means the real values are in the ZIP64 record, found through the locator right before
+    if (totalEntries == 0xFFFF || cdSize == 0xFFFFFFFF || cdOffset == 0xFFFFFFFF) {
+        const char *loc = eocdOffset >= kZip64LocatorSize ? map.at(eocdOffset - kZip64LocatorSize, kZip64LocatorSize) : nullptr;
+        if (!loc || qFromLittleEndian<quint32>(loc) != kZip64LocatorSig) return false;
+        const char *rec = map.at(toVirtual(qFromLittleEndian<quint32>(loc + 4), qint64(qFromLittleEndian<quint64>(loc + 8))),
+                                 kZip64EndOfCentralDirSize);
+        if (!rec || qFromLittleEndian<quint32>(rec) != kZip64EndOfCentralDirSig) return false;
+        cdDisk = qFromLittleEndian<quint32>(rec + 20);
+        totalEntries = qint64(qFromLittleEndian<quint64>(rec + 32));
+        cdSize = qint64(qFromLittleEndian<quint64>(rec + 40));
+        cdOffset = qint64(qFromLittleEndian<quint64>(rec + 48));
+    }
+    cdOffset = toVirtual(cdDisk, cdOffset);
+    if (totalEntries < 0 || cdSize < 0 || cdOffset < 0 || cdOffset + cdSize > fileSize) return false;
+
+    out.reserve(int(qMin<qint64>(totalEntries, cdSize / kZipCentralHeaderSize)));
+    const qint64 cdEnd = cdOffset + cdSize;
+    qint64 pos = cdOffset;
+    while (pos + kZipCentralHeaderSize <= cdEnd) {
+        const char *h = map.at(pos, kZipCentralHeaderSize);
+        if (!h || qFromLittleEndian<quint32>(h) != kZipCentralHeaderSig) break;
+        const int nameLen = qFromLittleEndian<quint16>(h + 28);
+        const int extraLen = qFromLittleEndian<quint16>(h + 30);
+        const int commentLen = qFromLittleEndian<quint16>(h + 32);
+        const qint64 recordLen = kZipCentralHeaderSize + nameLen + extraLen + commentLen;
+        if (pos + recordLen > cdEnd) return false;
+        h = map.at(pos, recordLen);   // the whole record, in one window
+        if (!h) return false;
+
+        ZipEntryInfo info;
+        info.flags = qFromLittleEndian<quint16>(h + 8);
+        info.method = qFromLittleEndian<quint16>(h + 10);
+        info.dosDateTime = qFromLittleEndian<quint32>(h + 12);
+        info.crc = qFromLittleEndian<quint32>(h + 16);
+        info.compressedSize = qFromLittleEndian<quint32>(h + 20);
+        info.size = qFromLittleEndian<quint32>(h + 24);
+        info.localHeaderOffset = qFromLittleEndian<quint32>(h + 42);
+        info.centralHeaderOffset = pos;
+        qint64 disk = qFromLittleEndian<quint16>(h + 34);
+        // ZIP64 extended information holds, in this order, only the fields saturated above
+        const char *extra = h + kZipCentralHeaderSize + nameLen;
+        for (int x = 0; x + 4 <= extraLen; ) {
+            const int id = qFromLittleEndian<quint16>(extra + x);
+            const int len = qFromLittleEndian<quint16>(extra + x + 2);
+            if (x + 4 + len > extraLen) break;
+            if (id == 0x0001) {
+                const char *p = extra + x + 4;
+                const char *end = p + len;
+                auto widen = [&p, end](qint64 &field) {
+                    if (field != 0xFFFFFFFF || p + 8 > end) return;
+                    field = qint64(qFromLittleEndian<quint64>(p));
+                    p += 8;
+                };
+                widen(info.size);
+                widen(info.compressedSize);
+                widen(info.localHeaderOffset);
+                if (disk == 0xFFFF && p + 4 <= end) disk = qFromLittleEndian<quint32>(p);
+            }
+            x += 4 + len;
+        }
+        info.localHeaderOffset = toVirtual(disk, info.localHeaderOffset);
+        if (info.localHeaderOffset < 0) return false;
+        const QByteArray rawName(h + kZipCentralHeaderSize, nameLen);
+        // bit 11: name is UTF-8, otherwise CP437 which is close enough to latin1 for display
+        info.name = (info.flags & 0x800) ? QString::fromUtf8(rawName) : QString::fromLatin1(rawName);
+        out << info;
+        pos += recordLen;
+    }
+    return out.size() == totalEntries;
+}
+
+// the local header repeats name/extra with possibly different lengths, so the payload offset must be read from it
+static qint64 zipEntryDataOffset(QIODevice &f, const ZipEntryInfo &info) {
+    if (!f.seek(info.localHeaderOffset)) return -1;
+    const QByteArray h = f.read(kZipLocalHeaderSize);
+    if (h.size() != kZipLocalHeaderSize || qFromLittleEndian<quint32>(h.constData()) != kZipLocalHeaderSig) return -1;
+    const int nameLen = qFromLittleEndian<quint16>(h.constData() + 26);
+    const int extraLen = qFromLittleEndian<quint16>(h.constData() + 28);
+    return info.localHeaderOffset + kZipLocalHeaderSize + nameLen + extraLen;
+}
+
+// --- Raw zip copy ---
+// entries are carried over as their local header, compressed bytes and data descriptor,
+// untouched; only the central directory is written anew, so nothing is inflated or deflated
+static const quint32 kZipDataDescriptorSig = 0x08074b50;
+
+class ZipRawWriter {
+public:
+    explicit ZipRawWriter(const QString &path) : m_file(path) {}
+
+    bool open() { return m_file.open(QIODevice::WriteOnly); }
+
+    // info must come from src's central directory; a non-empty name stores the entry under that name
+    bool copyEntry(QIODevice &src, const ZipEntryInfo &info, ArchiveOperation *op = nullptr, const QString &name = QString()) {
+        Headers h;
+        if (!readHeaders(src, info, h)) return false;
+        qint64 span = info.compressedSize;
+        // bit 3: crc and sizes follow the data, with an optional signature and 8-byte sizes under ZIP64
+        if (info.flags & 0x8) {
+            if (!src.seek(h.dataOffset + info.compressedSize)) return false;
+            const QByteArray sig = src.read(4);
+            if (sig.size() != 4) return false;
+            const bool zip64 = zipExtraField(h.names.constData() + h.nameLen, h.extraLen, 0x0001) != nullptr;
+            span += (qFromLittleEndian<quint32>(sig.constData()) == kZipDataDescriptorSig ? 4 : 0) + 4 + (zip64 ? 16 : 8);
+        }
+
+        // a renamed entry is written as UTF-8 and loses any Info-ZIP unicode path that would override it
+        const bool renamed = !name.isEmpty() && name != info.name;
+        const QByteArray rawName = renamed ? name.toUtf8() : h.names.left(h.nameLen);
+        const QByteArray localExtra = renamed ? withoutExtraFields(h.names.constData() + h.nameLen, h.extraLen, 0x7075)
+                                              : h.names.mid(h.nameLen);
+        ZipEntryInfo out = info;
+        if (renamed) {
+            out.flags |= 0x800;
+            qToLittleEndian<quint16>(out.flags, h.local.data() + 6);
+            qToLittleEndian<quint16>(quint16(rawName.size()), h.local.data() + 26);
+            qToLittleEndian<quint16>(quint16(localExtra.size()), h.local.data() + 28);
+        }
+
+        const qint64 offset = m_file.pos();
+        const QByteArray header = h.local + rawName + localExtra;
+        if (m_file.write(header) != header.size()) return false;
+        if (!src.seek(h.dataOffset) || !copyBytes(src, span, op)) return false;
+        appendCentral(h, out, offset, renamed ? rawName : QByteArray());
+        ++m_count;
+        return true;
+    }
+
+    // the entry with data, compressed with method, in place of its payload; everything else in its
+    // headers is kept, and the sizes go into the local header since there is no data descriptor
+    bool replaceEntry(QIODevice &src, const ZipEntryInfo &info, quint16 method, const QByteArray &data) {
+        Headers h;
+        if (!readHeaders(src, info, h)) return false;
+        ZipEntryInfo out = info;
+        out.flags &= ~quint16(0x8 | 0x6);   // sizes up front; bits 1-2 describe the old deflate options
+        out.method = method;
+        out.compressedSize = data.size();
+        QByteArray extra = withoutExtraFields(h.names.constData() + h.nameLen, h.extraLen, 0x0001);
+        const bool zip64 = out.size >= 0xFFFFFFFF || out.compressedSize >= 0xFFFFFFFF;
+        if (zip64) {
+            char block[20];
+            qToLittleEndian<quint16>(0x0001, block);
+            qToLittleEndian<quint16>(16, block + 2);
+            qToLittleEndian<quint64>(quint64(out.size), block + 4);
+            qToLittleEndian<quint64>(quint64(out.compressedSize), block + 12);
+            extra.prepend(QByteArray(block, 20));
+        }
+        char *l = h.local.data();
+        qToLittleEndian<quint16>(quint16(zip64 ? 45 : qMax<quint16>(20, qFromLittleEndian<quint16>(l + 4))), l + 4);
+        qToLittleEndian<quint16>(out.flags, l + 6);
+        qToLittleEndian<quint16>(out.method, l + 8);
+        qToLittleEndian<quint32>(out.crc, l + 14);
+        qToLittleEndian<quint32>(zip64 ? 0xFFFFFFFF : quint32(out.compressedSize), l + 18);
+        qToLittleEndian<quint32>(zip64 ? 0xFFFFFFFF : quint32(out.size), l + 22);
+        qToLittleEndian<quint16>(quint16(extra.size()), l + 28);
+
+        const qint64 offset = m_file.pos();
+        const QByteArray header = h.local + h.names.left(h.nameLen) + extra;
+        if (m_file.write(header) != header.size() || m_file.write(data) != data.size()) return false;
+        appendCentral(h, out, offset, QByteArray());
+        ++m_count;
+        return true;
+    }
+
+    bool commit() {
+        const qint64 cdOffset = m_file.pos();
+        const qint64 cdSize = m_central.size();
+        if (m_file.write(m_central) != cdSize) { cancel(); return false; }
+        QByteArray tail;
+        const bool zip64 = m_count >= 0xFFFF || cdOffset >= 0xFFFFFFFF || cdSize >= 0xFFFFFFFF;
+        if (zip64) {
+            QByteArray rec(kZip64EndOfCentralDirSize, '\0');
+            qToLittleEndian<quint32>(kZip64EndOfCentralDirSig, rec.data());
+            qToLittleEndian<quint64>(kZip64EndOfCentralDirSize - 12, rec.data() + 4);
+            qToLittleEndian<quint16>(45, rec.data() + 12);
+            qToLittleEndian<quint16>(45, rec.data() + 14);
+            qToLittleEndian<quint64>(quint64(m_count), rec.data() + 24);
+            qToLittleEndian<quint64>(quint64(m_count), rec.data() + 32);
+            qToLittleEndian<quint64>(quint64(cdSize), rec.data() + 40);
+            qToLittleEndian<quint64>(quint64(cdOffset), rec.data() + 48);
+            QByteArray loc(kZip64LocatorSize, '\0');
+            qToLittleEndian<quint32>(kZip64LocatorSig, loc.data());
+            qToLittleEndian<quint64>(quint64(cdOffset + cdSize), loc.data() + 8);
+            qToLittleEndian<quint32>(1, loc.data() + 16);
+            tail += rec;
+            tail += loc;
+        }
+        QByteArray eocd(kZipEndOfCentralDirSize, '\0');
+        qToLittleEndian<quint32>(kZipEndOfCentralDirSig, eocd.data());
+        qToLittleEndian<quint16>(quint16(qMin<qint64>(m_count, 0xFFFF)), eocd.data() + 8);
+        qToLittleEndian<quint16>(quint16(qMin<qint64>(m_count, 0xFFFF)), eocd.data() + 10);
+        qToLittleEndian<quint32>(quint32(qMin<qint64>(cdSize, 0xFFFFFFFF)), eocd.data() + 12);
+        qToLittleEndian<quint32>(quint32(qMin<qint64>(cdOffset, 0xFFFFFFFF)), eocd.data() + 16);
+        tail += eocd;
+        if (m_file.write(tail) != tail.size()) { cancel(); return false; }
+        return m_file.commit();
+    }
+
+    void cancel() { m_file.cancelWriting(); }
+
+    // the extra block with this id, or nullptr; the returned pointer is at its 4-byte header
+    static const char *zipExtraField(const char *extra, int len, quint16 id) {
+        for (int x = 0; x + 4 <= len; ) {
+            const int size = qFromLittleEndian<quint16>(extra + x + 2);
+            if (x + 4 + size > len) break;
+            if (qFromLittleEndian<quint16>(extra + x) == id) return extra + x;
+            x += 4 + size;
+        }
+        return nullptr;
+    }
+
+private:
+    static const qint64 kCopyBlock = 1024 * 1024;
+
+    bool copyBytes(QIODevice &src, qint64 len, ArchiveOperation *op) {
+        QByteArray buf;
+        while (len > 0) {
+            if (op && op->isCancelled()) return false;
+            buf = src.read(qMin(len, kCopyBlock));
+            if (buf.isEmpty() || m_file.write(buf) != buf.size()) return false;
+            len -= buf.size();
+            if (op) op->advance(buf.size());
+        }
+        return true;
+    }
+
+    // the extra blocks except those with id
+    static QByteArray withoutExtraFields(const char *extra, int len, quint16 id) {
+        QByteArray out;
+        for (int x = 0; x + 4 <= len; ) {
+            const quint16 field = qFromLittleEndian<quint16>(extra + x);
+            const int size = qFromLittleEndian<quint16>(extra + x + 2);
+            if (x + 4 + size > len) break;
+            if (field != id) out.append(extra + x, 4 + size);
+            x += 4 + size;
+        }
+        return out;
+    }
+
+    struct Headers {
+        QByteArray local;     // fixed part of the local header
+        QByteArray names;     // its name and extra field
+        int nameLen = 0;
+        int extraLen = 0;
+        qint64 dataOffset = 0;
+        QByteArray central;   // fixed part of the central header
+        QByteArray tail;      // its name, extra field and comment
+        int cNameLen = 0;
+        int cExtraLen = 0;
+    };
+
+    static bool readHeaders(QIODevice &src, const ZipEntryInfo &info, Headers &h) {
+        if (!src.seek(info.localHeaderOffset)) return false;
+        h.local = src.read(kZipLocalHeaderSize);
+        if (h.local.size() != kZipLocalHeaderSize || qFromLittleEndian<quint32>(h.local.constData()) != kZipLocalHeaderSig)
+            return false;
+        h.nameLen = qFromLittleEndian<quint16>(h.local.constData() + 26);
+        h.extraLen = qFromLittleEndian<quint16>(h.local.constData() + 28);
+        h.names = src.read(h.nameLen + h.extraLen);
+        if (h.names.size() != h.nameLen + h.extraLen) return false;
+        h.dataOffset = info.localHeaderOffset + kZipLocalHeaderSize + h.nameLen + h.extraLen;
+
+        // the central record keeps version, attributes and comment; offsets and ZIP64 fields are redone
+        if (!src.seek(info.centralHeaderOffset)) return false;
+        h.central = src.read(kZipCentralHeaderSize);
+        if (h.central.size() != kZipCentralHeaderSize || qFromLittleEndian<quint32>(h.central.constData()) != kZipCentralHeaderSig)
+            return false;
+        h.cNameLen = qFromLittleEndian<quint16>(h.central.constData() + 28);
+        h.cExtraLen = qFromLittleEndian<quint16>(h.central.constData() + 30);
+        const int commentLen = qFromLittleEndian<quint16>(h.central.constData() + 32);
+        h.tail = src.read(h.cNameLen + h.cExtraLen + commentLen);
+        return h.tail.size() == h.cNameLen + h.cExtraLen + commentLen;
+    }
+
+    // info holds what the entry is now: flags, method and sizes
+    void appendCentral(const Headers &h, const ZipEntryInfo &info, qint64 offset, const QByteArray &rawName) {
+        // the old ZIP64 block is dropped and one holding just the saturated fields takes its place
+        QByteArray central = h.central;
+        QByteArray extra = withoutExtraFields(h.tail.constData() + h.cNameLen, h.cExtraLen, 0x0001);
+        if (!rawName.isEmpty()) extra = withoutExtraFields(extra.constData(), extra.size(), 0x7075);
+        QByteArray zip64;
+        auto field = [&zip64](qint64 value, char *slot) {
+            if (value < 0xFFFFFFFF) { qToLittleEndian<quint32>(quint32(value), slot); return; }
+            qToLittleEndian<quint32>(0xFFFFFFFF, slot);
+            char wide[8];
+            qToLittleEndian<quint64>(quint64(value), wide);
+            zip64.append(wide, 8);
+        };
+        field(info.size, central.data() + 24);
+        field(info.compressedSize, central.data() + 20);
+        field(offset, central.data() + 42);
+        if (!zip64.isEmpty()) {
+            char head[4];
+            qToLittleEndian<quint16>(0x0001, head);
+            qToLittleEndian<quint16>(quint16(zip64.size()), head + 2);
+            extra.prepend(zip64);
+            extra.prepend(head, 4);
+            if (qFromLittleEndian<quint16>(central.constData() + 6) < 45) qToLittleEndian<quint16>(45, central.data() + 6);
+        }
+        qToLittleEndian<quint16>(info.flags, central.data() + 8);
+        qToLittleEndian<quint16>(info.method, central.data() + 10);
+        if (!rawName.isEmpty()) qToLittleEndian<quint16>(quint16(rawName.size()), central.data() + 28);
+        qToLittleEndian<quint16>(quint16(extra.size()), central.data() + 30);
+        qToLittleEndian<quint16>(0, central.data() + 34);   // the copy is a single volume
+        m_central += central;
+        m_central += rawName.isEmpty() ? h.tail.left(h.cNameLen) : rawName;
+        m_central += extra;
+        m_central += h.tail.mid(h.cNameLen + h.cExtraLen);
+    }
+
+    QSaveFile m_file;
+    QByteArray m_central;
+    qint64 m_count = 0;
+};
+
+// --- Seekable QIODevice over a single zip entry ---
+// stored entries map straight onto the archive so seeking is free; deflated
+// entries inflate forward and restart from the beginning on a backward seek.
+class ArchiveEntryDevice : public QIODevice {
+public:
+    ArchiveEntryDevice(const QString &archivePath, const ZipEntryInfo &info, QObject *parent = nullptr)
+        : QIODevice(parent), m_archivePath(archivePath), m_info(info) {}
+    ~ArchiveEntryDevice() override { close(); }
+
+    bool open(OpenMode mode) override {
+        if ((mode & WriteOnly) || !m_info.isNativelyReadable()) return false;
+        m_file.reset(openArchiveDevice(m_archivePath));
+        if (!m_file) return false;
+        m_dataOffset = zipEntryDataOffset(*m_file, m_info);
+        if (m_dataOffset < 0) { m_file.reset(); return false; }
+        if (m_info.method == 8 && !resetInflater()) { m_file.reset(); return false; }
+        if (m_info.method == 0) m_map.reset(new ArchiveMap(*m_file));
+        m_readPos = 0;
+        return QIODevice::open(mode | QIODevice::Unbuffered);
+    }
+
+    void close() override {
+        if (m_inflating) { inflateEnd(&m_zs); m_inflating = false; }
+        m_map.reset();
+        m_file.reset();
+        QIODevice::close();
+    }
+
+    bool isSequential() const override { return false; }
+    qint64 size() const override { return m_info.size; }
+
+    bool seek(qint64 pos) override {
+        if (pos < 0 || pos > m_info.size) return false;
+        m_readPos = pos;
+        return QIODevice::seek(pos);
+    }
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override {
+        maxSize = qMin(maxSize, m_info.size - m_readPos);
+        if (maxSize <= 0) return 0;
+        qint64 n = -1;
+        if (m_info.method == 0) {
+            // stored data is copied straight out of the mapping
+            n = qMin(maxSize, ArchiveMap::kWindow);
+            const char *p = m_map->at(m_dataOffset + m_readPos, n);
+            if (!p) return -1;
+            memcpy(data, p, size_t(n));
+        } else {
+            if (m_readPos < m_inflatedPos && !resetInflater()) return -1;
+            // skip forward to the requested position by inflating into scratch
+            char scratch[16384];
+            while (m_inflatedPos < m_readPos) {
+                const qint64 got = inflateInto(scratch, qMin<qint64>(sizeof(scratch), m_readPos - m_inflatedPos));
+                if (got <= 0) return -1;
+            }
+            n = inflateInto(data, maxSize);
+        }
+        if (n > 0) m_readPos += n;
+        return n;
+    }
+    qint64 writeData(const char *, qint64) override { return -1; }
+
+private:
+    bool resetInflater() {
+        if (m_inflating) inflateEnd(&m_zs);
+        memset(&m_zs, 0, sizeof(m_zs));
+        // raw deflate stream: negative window bits, no zlib header
+        m_inflating = inflateInit2(&m_zs, -MAX_WBITS) == Z_OK;
+        m_inflatedPos = 0;
+        m_compressedPos = 0;
+        return m_inflating;
+    }
+
+    qint64 inflateInto(char *out, qint64 len) {
+        m_zs.next_out = reinterpret_cast<Bytef*>(out);
+        m_zs.avail_out = uInt(len);
+        while (m_zs.avail_out > 0) {
+            if (m_zs.avail_in == 0 && m_compressedPos < m_info.compressedSize) {
+                if (!m_file->seek(m_dataOffset + m_compressedPos)) return -1;
+                const qint64 got = m_file->read(m_inBuf, qMin<qint64>(sizeof(m_inBuf), m_info.compressedSize - m_compressedPos));
+                if (got <= 0) return -1;
+                m_compressedPos += got;
+                m_zs.next_in = reinterpret_cast<Bytef*>(m_inBuf);
+                m_zs.avail_in = uInt(got);
+            }
+            const int rc = inflate(&m_zs, Z_NO_FLUSH);
+            if (rc == Z_STREAM_END) break;
+            if (rc != Z_OK && rc != Z_BUF_ERROR) return -1;
+            if (rc == Z_BUF_ERROR && m_zs.avail_in == 0 && m_compressedPos >= m_info.compressedSize) break;
+        }
+        const qint64 produced = len - m_zs.avail_out;
+        m_inflatedPos += produced;
+        return produced;
+    }
+
+    const QString m_archivePath;
+    QScopedPointer<QIODevice> m_file;
+    QScopedPointer<ArchiveMap> m_map;
+    ZipEntryInfo m_info;
+    qint64 m_dataOffset = -1;
+    qint64 m_readPos = 0;
+    z_stream m_zs;
+    bool m_inflating = false;
+    qint64 m_inflatedPos = 0;
+    qint64 m_compressedPos = 0;
+    char m_inBuf[65536];
+};
+
+// --- Output I/O engine ---
+// extraction hands finished buffers to an engine instead of writing them itself, so the
+// io_uring build can batch the writes, fsyncs and closes of many small files into a few
+// syscalls. Handles are plain ints (the fd on unix).
+class IoEngine {
+public:
+    virtual ~IoEngine() {}
+    virtual const char *name() const = 0;
+    void setSyncOnClose(bool sync) { m_sync = sync; }
+
+    // create/truncate path for writing; -1 on failure
+    virtual int open(const QString &path) = 0;
+    // queue data at offset; false once this handle has failed
+    virtual bool write(int handle, qint64 offset, const QByteArray &data) = 0;
+    // fsync if requested, then close; the file is removed if !keep or any write to it failed
+    virtual void close(int handle, bool keep) = 0;
+    // wait for everything queued so far; false if anything failed since the last flush
+    virtual bool flush() = 0;
+    // set the file length up front; ranges never written then read back as zeros (holes)
+    virtual bool resize(int handle, qint64 size) = 0;
+
+    // io_uring when built with liburing and the kernel allows it, pwrite otherwise (ZIPPY_IO=pwrite forces that)
+    static IoEngine *create();
+
+protected:
+    struct OpenFile {
+        QString path;
+        int pending = 0;
+        bool failed = false;
+        bool closing = false;
+        bool keep = true;
+        bool synced = false;
+    };
+
+    bool m_sync = false;
+    QMutex m_mutex;
+    QHash<int, OpenFile> m_open;
+    bool m_failed = false;
+};
+
+class SyncIoEngine : public IoEngine {
+public:
+#ifndef Q_OS_UNIX
+    ~SyncIoEngine() override { qDeleteAll(m_files); }
+#endif
+    const char *name() const override { return "pwrite"; }
+
+    int open(const QString &path) override {
+#ifdef Q_OS_UNIX
+        const int handle = ::open(QFile::encodeName(path).constData(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (handle < 0) return -1;
+        QMutexLocker lock(&m_mutex);
+#else
+        QFile *f = new QFile(path);
+        if (!f->open(QIODevice::WriteOnly | QIODevice::Truncate)) { delete f; return -1; }
+        QMutexLocker lock(&m_mutex);
+        const int handle = ++m_nextHandle;
+        m_files.insert(handle, f);
+#endif
+        m_open[handle].path = path;
+        return handle;
+    }
+
+    bool write(int handle, qint64 offset, const QByteArray &data) override {
+        bool ok = true;
+#ifdef Q_OS_UNIX
+        for (qint64 done = 0; ok && done < data.size(); ) {
+            const ssize_t n = ::pwrite(handle, data.constData() + done, size_t(data.size() - done), off_t(offset + done));
+            if (n < 0 && errno == EINTR) continue;
+            ok = n > 0;
+            done += n;
+        }
+#else
+        QFile *f = file(handle);
+        ok = f && f->seek(offset) && f->write(data) == data.size();
+#endif
+        if (!ok) {
+            QMutexLocker lock(&m_mutex);
+            m_open[handle].failed = m_failed = true;
+        }
+        return ok;
+    }
+
+    void close(int handle, bool keep) override {
+        OpenFile f;
+        {
+            QMutexLocker lock(&m_mutex);
+            f = m_open.take(handle);
+        }
+#ifdef Q_OS_UNIX
+        if (m_sync && keep && !f.failed && ::fsync(handle) != 0) f.failed = true;
+        ::close(handle);
+#else
+        QFile *qf = file(handle);
+        if (qf && m_sync && keep && !f.failed && !qf->flush()) f.failed = true;
+        delete qf;
+        QMutexLocker lock(&m_mutex);
+        m_files.remove(handle);
+        lock.unlock();
+#endif
+        if (!keep || f.failed) QFile::remove(f.path);
+        if (f.failed) {
+            QMutexLocker lock(&m_mutex);
+            m_failed = true;
+        }
+    }
+
+    bool flush() override {
+        QMutexLocker lock(&m_mutex);
+        const bool ok = !m_failed;
+        m_failed = false;
+        return ok;
+    }
+
+    bool resize(int handle, qint64 size) override {
+#ifdef Q_OS_UNIX
+        return ::ftruncate(handle, off_t(size)) == 0;
+#else
+        QFile *f = file(handle);
+        return f && f->resize(size);
+#endif
+    }
+
+#ifndef Q_OS_UNIX
+private:
+    // where there are no fds, handles index the open QFiles
+    QFile *file(int handle) {
+        QMutexLocker lock(&m_mutex);
+        return m_files.value(handle);
+    }
+
+    QHash<int, QFile*> m_files;
+    int m_nextHandle = 0;
+#endif
+};
+
+#ifdef ZIPPY_HAVE_LIBURING
+// writes are queued as SQEs and submitted when the ring fills up or on flush(); a file's
+// fsync is issued once its last write completes and its fd is closed after that
+class UringIoEngine : public IoEngine {
+public:
+    static const unsigned kDepth = 256;
+
+    bool init() {
+        m_ready = io_uring_queue_init(kDepth, &m_ring, 0) == 0;
+        return m_ready;
+    }
+    ~UringIoEngine() override {
+        if (!m_ready) return;
+        flush();
+        io_uring_queue_exit(&m_ring);
+    }
+    const char *name() const override { return "io_uring"; }
+
+    int open(const QString &path) override {
+        const int fd = ::open(QFile::encodeName(path).constData(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) return -1;
+        QMutexLocker lock(&m_mutex);
+        m_open[fd].path = path;
+        return fd;
+    }
+
+    bool write(int fd, qint64 offset, const QByteArray &data) override {
+        QMutexLocker lock(&m_mutex);
+        if (m_open.value(fd).failed) return false;
+        Request *r = new Request{fd, Request::Write, data, offset};
+        io_uring_sqe *sqe = nextSqeLocked();
+        io_uring_prep_write(sqe, fd, r->data.constData(), unsigned(r->data.size()), quint64(offset));
+        io_uring_sqe_set_data(sqe, r);
+        ++m_open[fd].pending;
+        ++m_inFlight;
+        return true;
+    }
+
+    void close(int fd, bool keep) override {
+        QMutexLocker lock(&m_mutex);
+        OpenFile &f = m_open[fd];
+        f.closing = true;
+        f.keep = keep;
+        if (f.pending == 0) finishLocked(fd);
+    }
+
+    bool flush() override {
+        QMutexLocker lock(&m_mutex);
+        while (m_inFlight > 0) {
+            io_uring_submit(&m_ring);
+            reapLocked(true);
+        }
+        const bool ok = !m_failed;
+        m_failed = false;
+        return ok;
+    }
+
+    // nothing for this fd is queued yet when the decoder calls this, so no ordering is needed
+    bool resize(int fd, qint64 size) override { return ::ftruncate(fd, off_t(size)) == 0; }
+
+private:
+    struct Request {
+        enum Kind { Write, Fsync };
+        int fd;
+        Kind kind;
+        QByteArray data;   // keeps the buffer alive until the kernel is done with it
+        qint64 offset;
+    };
+
+    // also caps the memory pinned by queued writes at kDepth buffers
+    io_uring_sqe *nextSqeLocked() {
+        while (m_inFlight >= int(kDepth)) {
+            io_uring_submit(&m_ring);
+            reapLocked(true);
+        }
+        io_uring_sqe *sqe = io_uring_get_sqe(&m_ring);
+        while (!sqe) {
+            io_uring_submit(&m_ring);
+            reapLocked(false);
+            sqe = io_uring_get_sqe(&m_ring);
+        }
+        return sqe;
+    }
+
+    void reapLocked(bool wait) {
+        io_uring_cqe *cqe = nullptr;
+        if (wait && io_uring_wait_cqe(&m_ring, &cqe) == 0) complete(cqe);
+        while (io_uring_peek_cqe(&m_ring, &cqe) == 0) complete(cqe);
+    }
+
+    void complete(io_uring_cqe *cqe) {
+        Request *r = static_cast<Request*>(io_uring_cqe_get_data(cqe));
+        const int res = cqe->res;
+        io_uring_cqe_seen(&m_ring, cqe);
+        bool ok = res >= 0;
+        if (ok && r->kind == Request::Write && res < r->data.size()) {
+            // short write: finish the tail synchronously rather than requeueing
+            for (qint64 done = res; ok && done < r->data.size(); ) {
+                const ssize_t n = ::pwrite(r->fd, r->data.constData() + done, size_t(r->data.size() - done), off_t(r->offset + done));
+                if (n < 0 && errno == EINTR) continue;
+                ok = n > 0;
+                if (ok) done += n;
+            }
+        }
+        OpenFile &f = m_open[r->fd];
+        if (!ok) f.failed = m_failed = true;
+        --f.pending;
+        --m_inFlight;
+        const int fd = r->fd;
+        delete r;
+        if (f.closing && f.pending == 0) finishLocked(fd);
+    }
+
+    void finishLocked(int fd) {
+        OpenFile &f = m_open[fd];
+        if (m_sync && f.keep && !f.failed && !f.synced) {
+            f.synced = true;
+            // called from completion handling, so don't wait for a free SQE here
+            if (io_uring_sqe *sqe = io_uring_get_sqe(&m_ring)) {
+                io_uring_prep_fsync(sqe, fd, 0);
+                io_uring_sqe_set_data(sqe, new Request{fd, Request::Fsync, QByteArray(), 0});
+                ++f.pending;
+                ++m_inFlight;
+                return;
+            }
+            if (::fsync(fd) != 0) f.failed = m_failed = true;
+        }
+        ::close(fd);
+        if (!f.keep || f.failed) QFile::remove(f.path);
+        m_open.remove(fd);
+    }
+
+    io_uring m_ring;
+    bool m_ready = false;
+    int m_inFlight = 0;
+};
+#endif
+
+IoEngine *IoEngine::create() {
+#ifdef ZIPPY_HAVE_LIBURING
+    if (qgetenv("ZIPPY_IO") != "pwrite") {
+        UringIoEngine *uring = new UringIoEngine;
+        if (uring->init()) return uring;
+        delete uring;   // old kernel or io_uring disabled by policy
+    }
+#endif
+    return new SyncIoEngine;
+}
+
+// knobs for the native extractor
+struct ExtractOptions {
+    // how byte-identical entries are materialised after the first one is decoded
+    enum class Dedup { None, Reflink, Hardlink };
+
+    bool syncOutput = false;        // fsync every extracted file before reporting success
+    Dedup dedup = Dedup::Reflink;   // reflinks fall back to a plain copy, so this is always safe
+    bool sparse = true;             // leave long zero runs in the output as holes
+    bool resumable = false;         // keep a journal in the destination so an interrupted run can pick up again
+};
+
+// make dest a copy of src, sharing its blocks where the filesystem allows
+static bool materializeDuplicate(const QString &src, const QString &dest, ExtractOptions::Dedup mode) {
+    QDir().mkpath(QFileInfo(dest).absolutePath());
+    QFile::remove(dest);
+    const QByteArray from = QFile::encodeName(src), to = QFile::encodeName(dest);
+#ifdef Q_OS_UNIX
+    if (mode == ExtractOptions::Dedup::Hardlink && ::link(from.constData(), to.constData()) == 0) return true;
+#endif
+    if (mode == ExtractOptions::Dedup::Reflink) {
+#if defined(Q_OS_LINUX) && defined(FICLONE)
+        const int in = ::open(from.constData(), O_RDONLY | O_CLOEXEC);
+        const int out = in < 0 ? -1 : ::open(to.constData(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        const bool cloned = out >= 0 && ::ioctl(out, FICLONE, in) == 0;
+        if (in >= 0) ::close(in);
+        if (out >= 0) ::close(out);
+        if (cloned) return true;
+        QFile::remove(dest);
+#elif defined(Q_OS_MACOS)
+        if (::clonefile(from.constData(), to.constData(), 0) == 0) return true;
+#endif
+    }
+    Q_UNUSED(from) Q_UNUSED(to)
+    // different filesystems, or one without reflinks
+    return QFile::copy(src, dest);
+}
+
+// --- Sparse output ---
+// the file is sized up front and zero runs of at least kSparseHoleMin (checked per
+// filesystem block) are simply not written, so they stay holes
+static const qint64 kSparseBlock = 4096;
+static const qint64 kSparseHoleMin = 64 * 1024;
+
+// true if p[0..n) is all zero bytes; ORs 64 bytes per step with SSE2, 8 at a time otherwise
+static bool isAllZero(const char *p, qint64 n) {
+    qint64 i = 0;
+#ifdef __SSE2__
+    for (; i + 64 <= n; i += 64) {
+        const __m128i *v = reinterpret_cast<const __m128i*>(p + i);
+        const __m128i acc = _mm_or_si128(_mm_or_si128(_mm_loadu_si128(v), _mm_loadu_si128(v + 1)),
+                                         _mm_or_si128(_mm_loadu_si128(v + 2), _mm_loadu_si128(v + 3)));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(acc, _mm_setzero_si128())) != 0xFFFF) return false;
+    }
+#endif
+    for (; i + 8 <= n; i += 8) {
+        quint64 w;
+        memcpy(&w, p + i, sizeof(w));
+        if (w) return false;
+    }
+    for (; i < n; ++i) {
+        if (p[i]) return false;
+    }
+    return true;
+}
+
+// call sink(fileOffset, bytes) for each part of data (which starts at fileOffset base) that must be written
+template<typename Sink>
+static void forEachDataSegment(const QByteArray &data, qint64 base, Sink sink) {
+    const qint64 n = data.size();
+    qint64 segStart = 0, zeroStart = -1;
+    auto endZeroRun = [&](qint64 at) {
+        if (zeroStart >= 0 && at - zeroStart >= kSparseHoleMin) {
+            if (zeroStart > segStart) sink(base + segStart, data.mid(int(segStart), int(zeroStart - segStart)));
+            segStart = at;
+        }
+        zeroStart = -1;
+    };
+    for (qint64 pos = 0; pos < n; ) {
+        // block boundaries follow file offsets so holes line up with filesystem blocks
+        const qint64 end = qMin(n, ((base + pos) / kSparseBlock + 1) * kSparseBlock - base);
+        if (isAllZero(data.constData() + pos, end - pos)) {
+            if (zeroStart < 0) zeroStart = pos;
+        } else {
+            endZeroRun(pos);
+        }
+        pos = end;
+    }
+    endZeroRun(n);
+    if (segStart == 0) sink(base, data);
+    else if (segStart < n) sink(base + segStart, data.mid(int(segStart)));
+}
+
+// reject absolute names and ".." components so a hostile entry can't write outside the target dir
+static bool isSafeEntryPath(const QString &name) {
+    if (name.isEmpty() || name.startsWith('/') || name.startsWith('\\') || name.contains(':')) return false;
+    for (const QString &part : name.split(QRegularExpression("[/\\\\]"), QString::SkipEmptyParts)) {
+        if (part == "..") return false;
+    }
+    return true;
+}
+
+// decode one entry into outPath and verify its CRC; a cancelled or failed run leaves no partial file behind
+static bool extractZipEntryToFile(const QString &archivePath, const ZipEntryInfo &info, const QString &outPath,
+                                  const CancelToken &cancel = CancelToken(), ArchiveOperation *op = nullptr) {
+    QDir().mkpath(QFileInfo(outPath).absolutePath());
+    if (info.isDir()) return QDir().mkpath(outPath);
+    ArchiveEntryDevice in(archivePath, info);
+    QFile out(outPath);
+    if (!in.open(QIODevice::ReadOnly) || !out.open(QIODevice::WriteOnly | QIODevice::Truncate)) return false;
+    QByteArray buf(256 * 1024, Qt::Uninitialized);
+    uLong crc = crc32(0L, Z_NULL, 0);
+    qint64 total = 0;
+    bool ok = true;
+    while (ok && total < info.size) {
+        if (cancel.isCancelled() || (op && op->isCancelled())) { ok = false; break; }
+        const qint64 n = in.read(buf.data(), buf.size());
+        if (n <= 0) { ok = false; break; }
+        crc = crc32(crc, reinterpret_cast<const Bytef*>(buf.constData()), uInt(n));
+        ok = out.write(buf.constData(), n) == n;
+        total += n;
+        if (op) op->advance(n);
+    }
+    ok = ok && total == info.size && crc == info.crc;
+    out.close();
+    if (!ok) out.remove();
+    return ok;
+}
+
+// same as above for a payload already read into memory, used by the batch workers; output
+// goes through the I/O engine, so write errors surface at the engine's next flush()
+static bool decodeZipPayloadToFile(const QByteArray &payload, const ZipEntryInfo &info, const QString &outPath,
+                                   IoEngine *io, bool sparse, ArchiveOperation *op = nullptr) {
+    static const int kOutChunk = 256 * 1024;
+    QDir().mkpath(QFileInfo(outPath).absolutePath());
+    const int out = io->open(outPath);
+    if (out < 0) return false;
+    sparse = sparse && info.size >= kSparseHoleMin && io->resize(out, info.size);
+    auto write = [&](qint64 offset, const QByteArray &bytes) {
+        if (!sparse) return io->write(out, offset, bytes);
+        bool written = true;
+        forEachDataSegment(bytes, offset, [&](qint64 at, const QByteArray &part) { written = io->write(out, at, part) && written; });
+        return written;
+    };
+    uLong crc = crc32(0L, Z_NULL, 0);
+    qint64 total = 0;
+    bool ok = true;
+    if (info.method == 0) {
+        crc = crc32(crc, reinterpret_cast<const Bytef*>(payload.constData()), uInt(payload.size()));
+        ok = write(0, payload);
+        total = payload.size();
+        if (op) op->advance(total);
+    } else {
+        z_stream zs;
+        memset(&zs, 0, sizeof(zs));
+        if (inflateInit2(&zs, -MAX_WBITS) != Z_OK) { io->close(out, false); return false; }
+        zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(payload.constData()));
+        zs.avail_in = uInt(payload.size());
+        int rc = Z_OK;
+        while (ok && rc != Z_STREAM_END) {
+            if (op && op->isCancelled()) { ok = false; break; }
+            // a fresh buffer each round: the engine may still hold the previous one
+            QByteArray buf(kOutChunk, Qt::Uninitialized);
+            zs.next_out = reinterpret_cast<Bytef*>(buf.data());
+            zs.avail_out = uInt(buf.size());
+            rc = inflate(&zs, Z_NO_FLUSH);
+            const int n = buf.size() - int(zs.avail_out);
+            // no output and no input left means the stream is truncated
+            if ((rc != Z_OK && rc != Z_STREAM_END) || (rc == Z_OK && n == 0 && zs.avail_in == 0)) { ok = false; break; }
+            if (n == 0) continue;
+            buf.resize(n);
+            crc = crc32(crc, reinterpret_cast<const Bytef*>(buf.constData()), uInt(n));
+            ok = write(total, buf);
+            total += n;
+            if (op) op->advance(n);
+        }
+        inflateEnd(&zs);
+    }
+    ok = ok && total == info.size && crc == info.crc;
+    io->close(out, ok);
+    return ok;
+}
+
+// --- Read-ahead and write-behind I/O for sequential extraction ---
+// tell the kernel we'll stream this range front to back so it reads ahead aggressively
+static void adviseSequentialRead(int fd, qint64 offset, qint64 len) {
+#if defined(Q_OS_UNIX) && defined(POSIX_FADV_SEQUENTIAL)
+    posix_fadvise(fd, offset, len, POSIX_FADV_SEQUENTIAL);
+    posix_fadvise(fd, offset, qMin<qint64>(len, 16 * 1024 * 1024), POSIX_FADV_WILLNEED);
+#elif defined(Q_OS_UNIX) && defined(F_RDAHEAD)
+    Q_UNUSED(offset) Q_UNUSED(len)
+    fcntl(fd, F_RDAHEAD, 1);
+#else
+    Q_UNUSED(fd) Q_UNUSED(offset) Q_UNUSED(len)
+#endif
+}
+
+// reads [start, end) of a file on its own thread into a ring of kSlots blocks, so the
+// next reads are already in flight while the consumer decodes the current block
+class ReadAheadStream {
+public:
+    static const qint64 kBlockSize = 4 * 1024 * 1024;
+    static const int kSlots = 3;
+
+    // reads from start to the end of the archive (all volumes of a split set)
+    ReadAheadStream(const QString &path, qint64 start)
+        : m_file(openArchiveDevice(path, QIODevice::ReadOnly | QIODevice::Unbuffered)),
+          m_end(m_file ? m_file->size() : 0), m_pos(start), m_fetchPos(start) {
+        if (!m_file) { m_error = true; return; }
+        if (QFile *f = qobject_cast<QFile*>(m_file.data())) adviseSequentialRead(f->handle(), start, m_end - start);
+        m_thread = QThread::create([this]() { produce(); });
+        m_thread->start();
+    }
+    ~ReadAheadStream() {
+        {
+            QMutexLocker lock(&m_mutex);
+            m_stop = true;
+            m_changed.wakeAll();
+        }
+        if (m_thread) { m_thread->wait(); delete m_thread; }
+    }
+
+    qint64 pos() const { return m_pos; }
+
+    // contiguous bytes at pos(), valid until the next consume()/seek(); nullptr at the end or on a read error
+    const char *peek(qint64 &avail) {
+        QMutexLocker lock(&m_mutex);
+        for (;;) {
+            while (!m_blocks.isEmpty() && m_blocks.first().offset + m_blocks.first().data.size() <= m_pos) {
+                m_blocks.removeFirst();
+                m_changed.wakeAll();
+            }
+            if (!m_blocks.isEmpty() || m_error || m_pos >= m_end) break;
+            m_changed.wait(&m_mutex);
+        }
+        if (m_blocks.isEmpty()) { avail = 0; return nullptr; }
+        const Block &b = m_blocks.first();
+        avail = b.offset + b.data.size() - m_pos;
+        return b.data.constData() + (m_pos - b.offset);
+    }
+
+    void consume(qint64 n) {
+        QMutexLocker lock(&m_mutex);
+        m_pos += n;
+    }
+
+    bool read(char *dst, qint64 len) {
+        while (len > 0) {
+            qint64 avail = 0;
+            const char *p = peek(avail);
+            if (!p) return false;
+            const qint64 n = qMin(avail, len);
+            memcpy(dst, p, size_t(n));
+            consume(n);
+            dst += n;
+            len -= n;
+        }
+        return true;
+    }
+
+    // jumps inside the window already being fetched just drop blocks; anything else restarts the read-ahead there
+    void seek(qint64 offset) {
+        QMutexLocker lock(&m_mutex);
+        if (offset >= m_pos && offset < m_fetchPos) { m_pos = offset; return; }
+        m_blocks.clear();
+        m_pos = m_fetchPos = offset;
+        ++m_generation;
+        m_changed.wakeAll();
+    }
+
+private:
+    struct Block {
+        qint64 offset;
+        QByteArray data;
+    };
+
+    void produce() {
+        for (;;) {
+            qint64 at = 0, len = 0;
+            quint64 generation = 0;
+            {
+                QMutexLocker lock(&m_mutex);
+                while (!m_stop && (m_blocks.size() >= kSlots || m_fetchPos >= m_end)) m_changed.wait(&m_mutex);
+                if (m_stop) return;
+                at = m_fetchPos;
+                len = qMin(kBlockSize, m_end - at);
+                generation = m_generation;
+                m_fetchPos += len;
+            }
+            Block b{at, QByteArray(int(len), Qt::Uninitialized)};
+            const bool good = m_file->seek(at) && m_file->read(b.data.data(), len) == len;
+            QMutexLocker lock(&m_mutex);
+            if (generation != m_generation) continue;   // the consumer jumped elsewhere meanwhile
+            if (!good) m_error = true;
+            else m_blocks << b;
+            m_changed.wakeAll();
+            if (!good) return;
+        }
+    }
+
+    QScopedPointer<QIODevice> m_file;   // only touched by the producer thread once it runs
+    const qint64 m_end;
+    QThread *m_thread = nullptr;
+    QMutex m_mutex;
+    QWaitCondition m_changed;
+    QList<Block> m_blocks;
+    qint64 m_pos;        // consumer position
+    qint64 m_fetchPos;   // next offset the producer will read
+    quint64 m_generation = 0;
+    bool m_stop = false;
+    bool m_error = false;
+};
+
+// one writer thread for a whole extraction: the decoder queues filled buffers (at most
+// kMaxPending, so output is triple-buffered) and keeps decoding while they hit the disk
+class WriteBehindQueue {
+public:
+    static const int kMaxPending = 3;
+
+    explicit WriteBehindQueue(bool syncOnClose = false) : m_sync(syncOnClose) {
+        m_thread = QThread::create([this]() { drain(); });
+        m_thread->start();
+    }
+    ~WriteBehindQueue() { finish(); }
+
+    // file must already be open; the queue owns it from the first write until close()
+    void write(QFile *file, qint64 offset, const QByteArray &data) { enqueue(Op{file, data, offset, Write}); }
+    // keep = false removes the file (failed or cancelled entry), as does any write error on it
+    void close(QFile *file, bool keep) { enqueue(Op{file, QByteArray(), 0, keep ? Close : Discard}); }
+
+    // flush everything queued and stop the thread; false if any write failed
+    bool finish() {
+        {
+            QMutexLocker lock(&m_mutex);
+            m_stop = true;
+            m_changed.wakeAll();
+        }
+        if (m_thread) { m_thread->wait(); delete m_thread; m_thread = nullptr; }
+        return !m_failed;
+    }
+
+    bool failed() {
+        QMutexLocker lock(&m_mutex);
+        return m_failed;
+    }
+
+    // block until every queued write and close has been carried out; false if any failed
+    bool waitIdle() {
+        QMutexLocker lock(&m_mutex);
+        while (!m_ops.isEmpty() || m_busy) m_changed.wait(&m_mutex);
+        return !m_failed;
+    }
+
+private:
+    enum Kind { Write, Close, Discard };
+    struct Op {
+        QFile *file;
+        QByteArray data;
+        qint64 offset;
+        Kind kind;
+    };
+
+    void enqueue(const Op &op) {
+        QMutexLocker lock(&m_mutex);
+        while (op.kind == Write && m_pendingBuffers >= kMaxPending) m_changed.wait(&m_mutex);
+        m_ops << op;
+        if (op.kind == Write) ++m_pendingBuffers;
+        m_changed.wakeAll();
+    }
+
+    void drain() {
+        QSet<QFile*> broken;
+        for (;;) {
+            Op op{nullptr, QByteArray(), 0, Write};
+            {
+                QMutexLocker lock(&m_mutex);
+                m_busy = false;
+                if (m_ops.isEmpty()) m_changed.wakeAll();   // for waitIdle()
+                while (m_ops.isEmpty() && !m_stop) m_changed.wait(&m_mutex);
+                if (m_ops.isEmpty()) return;
+                op = m_ops.takeFirst();
+                m_busy = true;
+            }
+            if (op.kind == Write) {
+                // sequential unless the decoder skipped a hole
+                const bool ok = broken.contains(op.file)
+                    || ((op.file->pos() == op.offset || op.file->seek(op.offset)) && op.file->write(op.data) == op.data.size());
+                if (!ok) broken.insert(op.file);
+                QMutexLocker lock(&m_mutex);
+                --m_pendingBuffers;
+                if (!ok) m_failed = true;
+                m_changed.wakeAll();
+            } else {
+#ifdef Q_OS_UNIX
+                if (m_sync && op.kind == Close && !broken.contains(op.file)
+                    && !(op.file->flush() && ::fsync(op.file->handle()) == 0)) {
+                    broken.insert(op.file);
+                    QMutexLocker lock(&m_mutex);
+                    m_failed = true;
+                }
+#endif
+                op.file->close();
+                if (op.kind == Discard || broken.remove(op.file)) op.file->remove();
+                delete op.file;
+            }
+        }
+    }
+
+    QThread *m_thread = nullptr;
+    QMutex m_mutex;
+    QWaitCondition m_changed;
+    QList<Op> m_ops;
+    const bool m_sync;
+    int m_pendingBuffers = 0;
+    bool m_busy = false;
+    bool m_stop = false;
+    bool m_failed = false;
+};
+
+// decode one entry straight off the read-ahead stream (positioned at its payload) into outPath through the writer;
+// payloadHash, if given, is fed the compressed bytes on the way
+static bool decodeZipStreamToFile(ReadAheadStream &in, const ZipEntryInfo &info, const QString &outPath,
+                                  WriteBehindQueue &writer, bool sparse, ArchiveOperation *op = nullptr,
+                                  QCryptographicHash *payloadHash = nullptr) {
+    static const int kOutChunk = 1024 * 1024;
+    QDir().mkpath(QFileInfo(outPath).absolutePath());
+    QFile *out = new QFile(outPath);
+    if (!out->open(QIODevice::WriteOnly | QIODevice::Truncate)) { delete out; return false; }
+    sparse = sparse && info.size >= kSparseHoleMin && out->resize(info.size);
+    auto write = [&](qint64 offset, const QByteArray &bytes) {
+        if (!sparse) writer.write(out, offset, bytes);
+        else forEachDataSegment(bytes, offset, [&](qint64 at, const QByteArray &part) { writer.write(out, at, part); });
+    };
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    const bool inflating = info.method == 8;
+    if (inflating && inflateInit2(&zs, -MAX_WBITS) != Z_OK) { writer.close(out, false); return false; }
+
+    uLong crc = crc32(0L, Z_NULL, 0);
+    qint64 total = 0;
+    qint64 remaining = info.compressedSize;
+    int rc = Z_OK;
+    bool ok = true;
+    while (ok && remaining > 0 && rc != Z_STREAM_END) {
+        if ((op && op->isCancelled()) || writer.failed()) { ok = false; break; }
+        qint64 avail = 0;
+        const char *p = in.peek(avail);
+        if (!p) { ok = false; break; }
+        const qint64 take = qMin(avail, remaining);
+        qint64 used = take;
+        if (!inflating) {
+            const QByteArray chunk(p, int(take));
+            crc = crc32(crc, reinterpret_cast<const Bytef*>(chunk.constData()), uInt(take));
+            write(total, chunk);
+            total += take;
+            if (op) op->advance(take);
+        } else {
+            zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(p));
+            zs.avail_in = uInt(take);
+            for (;;) {
+                QByteArray chunk(kOutChunk, Qt::Uninitialized);
+                zs.next_out = reinterpret_cast<Bytef*>(chunk.data());
+                zs.avail_out = uInt(chunk.size());
+                rc = inflate(&zs, Z_NO_FLUSH);
+                if (rc != Z_OK && rc != Z_STREAM_END && rc != Z_BUF_ERROR) { ok = false; break; }
+                const int n = chunk.size() - int(zs.avail_out);
+                if (n > 0) {
+                    chunk.resize(n);
+                    crc = crc32(crc, reinterpret_cast<const Bytef*>(chunk.constData()), uInt(n));
+                    write(total, chunk);
+                    total += n;
+                    if (op) op->advance(n);
+                }
+                // a full output chunk may leave more pending even with the input drained
+                if (rc == Z_STREAM_END || (zs.avail_in == 0 && zs.avail_out != 0)) break;
+            }
+            used = take - zs.avail_in;
+        }
+        if (payloadHash) payloadHash->addData(p, int(used));
+        in.consume(used);
+        remaining -= used;
+    }
+    if (inflating) inflateEnd(&zs);
+    ok = ok && total == info.size && crc == info.crc;
+    writer.close(out, ok);
+    return ok;
+}
+
+// --- Resume journal for extraction ---
+// a small append-only file in the destination listing entries known to be completely on
+// disk. Records are committed at checkpoints, after everything queued before them has been
+// flushed, so a rerun against the same archive can skip them; anything else is extracted
+// again, and opening it for writing truncates whatever partial file was left.
+class ExtractJournal {
+public:
+    ExtractJournal(const QString &destDir, const QString &archivePath)
+        : m_dest(destDir), m_file(QDir(destDir).filePath(".zippy-extract.journal")) {
+        const QFileInfo fi(archivePath);
+        // a different or rewritten archive invalidates everything recorded
+        m_identity = QString("%1\t%2\t%3").arg(fi.absoluteFilePath()).arg(fi.size())
+                         .arg(fi.lastModified().toMSecsSinceEpoch()).toUtf8();
+    }
+
+    // load earlier progress if it was for this archive, then start appending
+    bool open() {
+        if (m_file.open(QIODevice::ReadOnly)) {
+            if (m_file.readLine().trimmed() == m_identity) {
+                while (!m_file.atEnd()) {
+                    // crc \t size \t percent-encoded name
+                    const QList<QByteArray> parts = m_file.readLine().trimmed().split('\t');
+                    if (parts.size() != 3) break;   // torn last line
+                    m_done.insert(QString::fromUtf8(QByteArray::fromPercentEncoding(parts.at(2))),
+                                  qMakePair(parts.at(0).toUInt(nullptr, 16), parts.at(1).toLongLong()));
+                }
+            }
+            m_file.close();
+        }
+        const bool resuming = !m_done.isEmpty();
+        if (!m_file.open(resuming ? QIODevice::Append : QIODevice::WriteOnly | QIODevice::Truncate)) return false;
+        if (!resuming) m_file.write(m_identity + '\n');
+        return m_file.flush();
+    }
+
+    // recorded with the same crc and size, and the file is still there at that size
+    bool isDone(const ZipEntryInfo &e) const {
+        auto it = m_done.constFind(e.name);
+        return it != m_done.constEnd() && it.value().first == e.crc && it.value().second == e.size
+            && QFileInfo(m_dest.filePath(e.name)).size() == e.size;
+    }
+
+    void record(const ZipEntryInfo &e) {
+        m_pending += QByteArray::number(e.crc, 16) + '\t' + QByteArray::number(e.size) + '\t'
+                   + e.name.toUtf8().toPercentEncoding() + '\n';
+    }
+
+    bool commit(bool sync) {
+        if (m_pending.isEmpty()) return true;
+        bool ok = m_file.write(m_pending) == m_pending.size() && m_file.flush();
+#ifdef Q_OS_UNIX
+        if (ok && sync) ok = ::fsync(m_file.handle()) == 0;
+#else
+        Q_UNUSED(sync)
+#endif
+        m_pending.clear();
+        return ok;
+    }
+
+    // the run finished, nothing to resume
+    void remove() {
+        m_file.close();
+        m_file.remove();
+    }
+
+private:
+    const QDir m_dest;
+    QFile m_file;
+    QByteArray m_identity;
+    QHash<QString, QPair<quint32, qint64>> m_done;
+    QByteArray m_pending;
+};
+
+// hash len compressed bytes off the stream without decoding them
+static bool hashStreamPayload(ReadAheadStream &in, qint64 len, QCryptographicHash &hash) {
+    while (len > 0) {
+        qint64 avail = 0;
+        const char *p = in.peek(avail);
+        if (!p) return false;
+        const qint64 n = qMin(avail, len);
+        hash.addData(p, int(n));
+        in.consume(n);
+        len -= n;
+    }
+    return true;
+}
+
+// extract entries in local-header order so the archive is read front to back once.
+// A read-ahead thread keeps the next blocks of the archive in memory; small payloads
+// are handed to a worker pool for decoding (memory in flight is capped), large ones
+// are inflated by this thread with their output written behind by another.
+// Entries whose CRC, sizes and method match an earlier one are only read and hashed;
+// if their compressed bytes match too they become reflinks/hardlinks of it at the end.
+// With options.resumable, finished entries are journaled every kCheckpointBytes and
+// after each large entry, and entries a previous run finished are skipped.
+static bool extractZipEntriesSequential(const QString &archivePath, QVector<ZipEntryInfo> entries, const QString &destDir,
+                                        const ExtractOptions &options, ArchiveOperation *op = nullptr) {
+    static const qint64 kInlineLimit = 16 * 1024 * 1024;
+    static const qint64 kBudgetUnit = 64 * 1024;
+    static const int kBudgetUnits = 2048;   // 128 MiB of compressed data waiting for a worker
+    static const qint64 kCheckpointBytes = 256 * 1024 * 1024;
+
+    std::sort(entries.begin(), entries.end(), [](const ZipEntryInfo &a, const ZipEntryInfo &b) {
+        return a.localHeaderOffset < b.localHeaderOffset;
+    });
+    ReadAheadStream in(archivePath, entries.isEmpty() ? 0 : entries.first().localHeaderOffset);
+    WriteBehindQueue writer(options.syncOutput);
+    QScopedPointer<IoEngine> io(IoEngine::create());
+    io->setSyncOnClose(options.syncOutput);
+    const QDir dest(destDir);
+    QThreadPool workers;
+    workers.setMaxThreadCount(qMax(1, QThread::idealThreadCount()));
+    QSemaphore budget(kBudgetUnits);
+    QAtomicInt failed(0);
+
+    // the first entry of each (crc, sizes, method) group is the source the others may copy
+    QVector<int> sourceOf(entries.size(), -1);
+    QSet<int> sources;
+    if (options.dedup != ExtractOptions::Dedup::None) {
+        QHash<QString, int> firstByKey;
+        for (int i = 0; i < entries.size(); ++i) {
+            const ZipEntryInfo &e = entries.at(i);
+            if (e.isDir() || e.size == 0) continue;
+            const QString key = QString("%1:%2:%3:%4").arg(e.crc).arg(e.size).arg(e.compressedSize).arg(e.method);
+            auto it = firstByKey.constFind(key);
+            if (it == firstByKey.constEnd()) {
+                firstByKey.insert(key, i);
+            } else if (dest.filePath(entries.at(it.value()).name) != dest.filePath(e.name)) {
+                sourceOf[i] = it.value();
+                sources.insert(it.value());
+            }
+        }
+    }
+    QHash<int, QByteArray> sourceHash;   // sha1 of each source's compressed payload
+    QVector<QPair<int, int>> copies;     // (entry, source) confirmed identical
+
+    QScopedPointer<ExtractJournal> journal;
+    if (options.resumable) {
+        QDir().mkpath(destDir);
+        journal.reset(new ExtractJournal(destDir, archivePath));
+        if (!journal->open()) journal.reset();   // read-only destination etc.: extract without resume support
+    }
+    QMutex doneMutex;
+    QVector<int> done;   // finished since the last checkpoint
+    qint64 sinceCheckpoint = 0;
+    // drain the pipeline so everything reported done is really written, then journal it
+    auto checkpoint = [&]() {
+        sinceCheckpoint = 0;
+        if (!journal) return;
+        workers.waitForDone();
+        if (!io->flush() || !writer.waitIdle()) { failed.store(1); return; }
+        QMutexLocker lock(&doneMutex);
+        for (int i : done) journal->record(entries.at(i));
+        done.clear();
+        journal->commit(options.syncOutput);
+    };
+
+    for (int i = 0; i < entries.size(); ++i) {
+        const ZipEntryInfo &e = entries.at(i);
+        if (failed.load() || (op && op->isCancelled())) break;
+        const QString outPath = dest.filePath(e.name);
+        if (e.isDir()) {
+            QDir().mkpath(outPath);
+            if (op) op->advance(0, 1, e.name);
+            continue;
+        }
+        if (journal && journal->isDone(e)) {
+            if (op) op->advance(e.size, 1, e.name);
+            continue;
+        }
+        if (sinceCheckpoint >= kCheckpointBytes) checkpoint();
+        sinceCheckpoint += e.compressedSize;
+        // the local header repeats name/extra with possibly different lengths
+        char header[kZipLocalHeaderSize];
+        in.seek(e.localHeaderOffset);
+        if (!in.read(header, kZipLocalHeaderSize) || qFromLittleEndian<quint32>(header) != kZipLocalHeaderSig) {
+            failed.store(1);
+            break;
+        }
+        in.seek(in.pos() + qFromLittleEndian<quint16>(header + 26) + qFromLittleEndian<quint16>(header + 28));
+        const int source = sourceOf.at(i);
+        const bool maybeCopy = source >= 0 && sourceHash.contains(source);
+        if (e.compressedSize > kInlineLimit) {
+            if (maybeCopy) {
+                const qint64 dataOffset = in.pos();
+                QCryptographicHash hash(QCryptographicHash::Sha1);
+                if (!hashStreamPayload(in, e.compressedSize, hash)) { failed.store(1); break; }
+                if (hash.result() == sourceHash.value(source)) { copies << qMakePair(i, source); continue; }
+                in.seek(dataOffset);   // same crc and sizes but different bytes: decode it after all
+            }
+            QCryptographicHash hash(QCryptographicHash::Sha1);
+            if (!decodeZipStreamToFile(in, e, outPath, writer, options.sparse, op, sources.contains(i) ? &hash : nullptr)) { failed.store(1); break; }
+            if (sources.contains(i)) sourceHash.insert(i, hash.result());
+            if (op) op->advance(0, 1, e.name);
+            {
+                QMutexLocker lock(&doneMutex);
+                done << i;
+            }
+            checkpoint();
+            continue;
+        }
+        QByteArray payload(int(e.compressedSize), Qt::Uninitialized);
+        if (!in.read(payload.data(), e.compressedSize)) { failed.store(1); break; }
+        if (maybeCopy || sources.contains(i)) {
+            const QByteArray digest = QCryptographicHash::hash(payload, QCryptographicHash::Sha1);
+            if (maybeCopy && digest == sourceHash.value(source)) { copies << qMakePair(i, source); continue; }
+            if (sources.contains(i)) sourceHash.insert(i, digest);
+        }
+        const int units = int(qMin<qint64>(kBudgetUnits, e.compressedSize / kBudgetUnit + 1));
+        budget.acquire(units);
+        IoEngine *engine = io.data();
+        const bool sparse = options.sparse;
+        workers.start(new FunctionRunnable([payload, e, i, outPath, op, units, engine, sparse,
+                                            &budget, &failed, &doneMutex, &done]() {
+            if (!failed.load() && !(op && op->isCancelled())) {
+                if (decodeZipPayloadToFile(payload, e, outPath, engine, sparse, op)) {
+                    if (op) op->advance(0, 1, e.name);
+                    QMutexLocker lock(&doneMutex);
+                    done << i;
+                } else {
+                    failed.store(1);
+                }
+            }
+            budget.release(units);
+        }));
+    }
+    workers.waitForDone();
+    if (!io->flush()) failed.store(1);
+    if (!writer.finish()) failed.store(1);
+
+    // sources are all on disk now
+    for (const QPair<int, int> &c : copies) {
+        if (failed.load() || (op && op->isCancelled())) break;
+        const ZipEntryInfo &e = entries.at(c.first);
+        if (!materializeDuplicate(dest.filePath(entries.at(c.second).name), dest.filePath(e.name), options.dedup)) {
+            failed.store(1);
+            break;
+        }
+        if (op) op->advance(e.size, 1, e.name);
+        done << c.first;
+    }
+
+    const bool ok = !failed.load() && !(op && op->isCancelled());
+    if (journal) {
+        if (ok) {
+            journal->remove();
+        } else {
+            // keep what did finish for the next run; a failed write already removed its file, which isDone() notices
+            for (int i : done) journal->record(entries.at(i));
+            journal->commit(options.syncOutput);
+        }
+    }
+    return ok;
+}
+
+// --- Zip integrity test ---
+// every entry is inflated on a worker pool and its crc and size compared with the central
+// directory; nothing is written anywhere
+static bool testZipEntries(const QString &path, QVector<ZipEntryInfo> entries, TestResult &result, ArchiveOperation *op) {
+    QElapsedTimer clock;
+    clock.start();
+    result = TestResult();
+    result.entries = entries.size();
+    // in archive order, so the workers between them read the file roughly front to back
+    std::sort(entries.begin(), entries.end(), [](const ZipEntryInfo &a, const ZipEntryInfo &b) {
+        return a.localHeaderOffset < b.localHeaderOffset;
+    });
+    for (const ZipEntryInfo &e : entries) {
+        if (e.isNativelyReadable()) result.bytes += e.size;
+        else if (!e.isDir()) result.unchecked << e.name;
+    }
+    if (op) op->begin(entries.size(), result.bytes);
+    QVector<char> bad(entries.size(), 0);
+    parallelForEach(entries.size(), [&](int i) {
+        const ZipEntryInfo &e = entries.at(i);
+        if (op && op->isCancelled()) return;
+        if (e.isNativelyReadable() && !e.isDir()) {
+            ArchiveEntryDevice in(path, e);
+            uLong crc = crc32(0, nullptr, 0);
+            qint64 total = 0;
+            bool ok = in.open(QIODevice::ReadOnly);
+            QByteArray buf(256 * 1024, Qt::Uninitialized);
+            while (ok) {
+                if (op && op->isCancelled()) return;
+                const qint64 n = in.read(buf.data(), buf.size());
+                if (n <= 0) { ok = n == 0; break; }
+                crc = crc32(crc, reinterpret_cast<const Bytef*>(buf.constData()), uInt(n));
+                total += n;
+                if (op) op->advance(n);
+            }
+            bad[i] = !ok || total != e.size || quint32(crc) != e.crc;
+        }
+        if (op) op->advance(0, 1, e.name);
+    });
+    if (op && op->isCancelled()) return false;
+    for (int i = 0; i < entries.size(); ++i) {
+        if (bad.at(i)) result.corrupt << entries.at(i).name;
+    }
+    result.elapsedMs = clock.elapsed();
+    if (op) op->finish();
+    return true;
+}
+
+// --- Zip optimize ---
+// entries are inflated and deflated again at the target level on a worker pool, a batch at a
+// time, and written in archive order behind the ones before them. An entry is copied as it is
+// when the new stream isn't smaller, when it was deflated at maximum already, or when deflate
+// barely shrank it before.
+static const qint64 kOptimizeBatchBytes = 64 * 1024 * 1024;
+static const qint64 kOptimizeMaxEntry = 256 * 1024 * 1024;   // held in memory whole, larger ones are copied
+
+// the entry's payload deflated at level into out; the crc and size are checked on the way
+static bool deflateZipEntry(const QString &archivePath, const ZipEntryInfo &info, int level, QByteArray &out,
+                            ArchiveOperation *op) {
+    ArchiveEntryDevice in(archivePath, info);
+    if (!in.open(QIODevice::ReadOnly)) return false;
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    if (deflateInit2(&zs, level, Z_DEFLATED, -MAX_WBITS, 9, Z_DEFAULT_STRATEGY) != Z_OK) return false;
+    out.resize(int(deflateBound(&zs, uLong(info.size))));
+    zs.next_out = reinterpret_cast<Bytef*>(out.data());
+    zs.avail_out = uInt(out.size());
+    uLong crc = crc32(0, nullptr, 0);
+    qint64 total = 0;
+    int rc = Z_OK;
+    while (rc == Z_OK) {
+        if (op && op->isCancelled()) break;
+        const QByteArray buf = in.read(256 * 1024);
+        crc = crc32(crc, reinterpret_cast<const Bytef*>(buf.constData()), uInt(buf.size()));
+        total += buf.size();
+        zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(buf.constData()));
+        zs.avail_in = uInt(buf.size());
+        rc = deflate(&zs, buf.isEmpty() ? Z_FINISH : Z_NO_FLUSH);
+        if (op) op->advance(buf.size());
+    }
+    deflateEnd(&zs);
+    out.resize(int(zs.total_out));
+    return rc == Z_STREAM_END && total == info.size && quint32(crc) == info.crc;
+}
+
+// the rewrite is left in writer, complete but not committed, so the caller decides whether it lands
+static bool optimizeZipArchive(const QString &path, QVector<ZipEntryInfo> entries, int level, ZipRawWriter &writer,
+                               OptimizeResult &result, ArchiveOperation *op) {
+    result = OptimizeResult();
+    result.sizeBefore = QFileInfo(path).size();
+    result.entries = entries.size();
+    std::sort(entries.begin(), entries.end(), [](const ZipEntryInfo &a, const ZipEntryInfo &b) {
+        return a.localHeaderOffset < b.localHeaderOffset;
+    });
+    auto worthTrying = [level](const ZipEntryInfo &e) {
+        if (e.isDir() || !e.isNativelyReadable() || e.size == 0 || e.size > kOptimizeMaxEntry) return false;
+        if (e.method == 8 && ((e.flags >> 1) & 3) == 1 && level >= 8) return false;
+        return !(e.method == 8 && e.compressedSize * 50 >= e.size * 49);
+    };
+    qint64 total = 0;
+    for (const ZipEntryInfo &e : entries) {
+        if (worthTrying(e)) total += e.size;
+    }
+
+    QScopedPointer<QIODevice> src(openArchiveDevice(path));
+    if (!src || !writer.open()) return false;
+    if (op) op->begin(entries.size(), total);
+    QThreadPool workers;
+    workers.setMaxThreadCount(qMax(1, QThread::idealThreadCount()));
+    for (int first = 0; first < entries.size(); ) {
+        int last = first;
+        qint64 batchBytes = 0;
+        while (last < entries.size() && (last == first || batchBytes < kOptimizeBatchBytes)) {
+            if (worthTrying(entries.at(last))) batchBytes += entries.at(last).size;
+            ++last;
+        }
+        QVector<QByteArray> packed(last - first);
+        QAtomicInt failed(0);
+        for (int i = first; i < last; ++i) {
+            if (!worthTrying(entries.at(i))) continue;
+            const ZipEntryInfo &e = entries.at(i);
+            QByteArray *out = &packed[i - first];
+            workers.start(new FunctionRunnable([&path, &e, level, out, op, &failed]() {
+                if (failed.load() || !deflateZipEntry(path, e, level, *out, op)) failed.store(1);
+            }));
+        }
+        workers.waitForDone();
+        if (failed.load() || (op && op->isCancelled())) { writer.cancel(); return false; }
+        for (int i = first; i < last; ++i) {
+            const ZipEntryInfo &e = entries.at(i);
+            const QByteArray &data = packed.at(i - first);
+            const bool smaller = !data.isEmpty() && data.size() < e.compressedSize;
+            if (smaller ? !writer.replaceEntry(*src, e, 8, data) : !writer.copyEntry(*src, e)) { writer.cancel(); return false; }
+            if (smaller) ++result.recompressed;
+            result.bytes += worthTrying(e) ? e.size : 0;
+            if (op) op->advance(0, 1, e.name);
+        }
+        first = last;
+    }
+    return true;
+}
+
+// --- Native zip handler: reads the central directory itself, writes and encrypted entries still go through the CLI ---
+class NativeArchiveHandler : public CliArchiveHandler {
+public:
+    NativeArchiveHandler(QObject *parent = nullptr) : CliArchiveHandler(parent) {}
+
+    bool openArchive(const QString &path) override {
+        if (!CliArchiveHandler::openArchive(path)) return false;
+        reloadCentralDirectory();
+        return true;
+    }
+
+    QStringList listEntries(const QString &prefix = QString()) const override {
+        QReadLocker lock(&m_lock);
+        if (!m_cdValid) return CliArchiveHandler::listEntries(prefix);
+        QStringList entries;
+        for (const ZipEntryInfo &e : m_entries) {
+            if (prefix.isEmpty() || e.name.startsWith(prefix)) entries << e.name;
+        }
+        return entries;
+    }
+
+    bool extractEntryToTemp(const QString &entry, QString &outPath) override {
+        ZipEntryInfo info;
+        if (!entryInfo(entry, info) || !info.isNativelyReadable()) return CliArchiveHandler::extractEntryToTemp(entry, outPath);
+        if (!isSafeEntryPath(entry)) return false;
+        QString persistentTmp = QDir::temp().filePath(QString("qt_arch_tmp_%1").arg(QUuid::createUuid().toString()));
+        QString target = QDir(persistentTmp).filePath(entry);
+        if (!extractZipEntryToFile(archivePath(), info, target)) return false;
+        outPath = target;
+        return true;
+    }
+
+    bool extractAll(const QString &destDir, ArchiveOperation *op = nullptr) override {
+        QVector<ZipEntryInfo> entries = snapshotEntries();
+        bool native = !entries.isEmpty();
+        qint64 total = 0;
+        for (const ZipEntryInfo &e : entries) {
+            if (!e.isNativelyReadable() || !isSafeEntryPath(e.name)) native = false;
+            total += e.size;
+        }
+        if (!native) return CliArchiveHandler::extractAll(destDir, op);
+
+        if (op) op->begin(entries.size(), total);
+        // a cancelled entry is removed by the decoder, finished ones stay and are
+        // journaled, so extracting into the same directory again resumes
+        ExtractOptions options = extractOptions();
+        options.resumable = true;
+        if (!extractZipEntriesSequential(archivePath(), entries, destDir, options, op)) return false;
+        if (op) op->finish();
+        return true;
+    }
+
+    bool extractEntries(const QStringList &names, const QString &destDir, ArchiveOperation *op = nullptr) override {
+        QVector<ZipEntryInfo> entries;
+        qint64 total = 0;
+        for (const QString &name : names) {
+            ZipEntryInfo info;
+            if (!entryInfo(name, info) || !info.isNativelyReadable() || !isSafeEntryPath(name))
+                return CliArchiveHandler::extractEntries(names, destDir, op);
+            entries << info;
+            total += info.size;
+        }
+        if (op) op->begin(entries.size(), total);
+        if (!extractZipEntriesSequential(archivePath(), entries, destDir, extractOptions(), op)) return false;
+        if (op) op->finish();
+        return true;
+    }
+
+    bool addFiles(const QStringList &files, const QString &destPathInArchive, ArchiveOperation *op = nullptr) override {
+        QMutexLocker lock(&m_editMutex);
+        bool ok = CliArchiveHandler::addFiles(files, destPathInArchive, op);
+        reloadCentralDirectory();
+        return ok;
+    }
+
+    bool removeEntries(const QStringList &entries, ArchiveOperation *op = nullptr) override {
+        QMutexLocker lock(&m_editMutex);
+        bool ok = CliArchiveHandler::removeEntries(entries, op);
+        reloadCentralDirectory();
+        return ok;
+    }
+
+    bool testArchive(TestResult &result, ArchiveOperation *op = nullptr) override {
+        if (!hasCentralDirectory()) return false;
+        return testZipEntries(archivePath(), snapshotEntries(), result, op);
+    }
+
+    // deflate at level 1-9. The rewrite runs without blocking edits and, as with .vfsarc compaction,
+    // only lands if the archive is still the one it was made from
+    bool optimize(int level, OptimizeResult &result, ArchiveOperation *op = nullptr) override {
+        if (level < 1 || level > 9) return false;
+        QElapsedTimer clock;
+        clock.start();
+        QVector<ZipEntryInfo> entries;
+        QPair<qint64, qint64> stamp;
+        {
+            QMutexLocker lock(&m_editMutex);
+            entries = snapshotEntries();
+            stamp = fileStamp();
+        }
+        if (entries.isEmpty()) return false;
+        ZipRawWriter writer(archivePath());
+        if (!optimizeZipArchive(archivePath(), entries, level, writer, result, op)) { writer.cancel(); return false; }
+        QMutexLocker lock(&m_editMutex);
+        if (fileStamp() != stamp) { writer.cancel(); return false; }
+        if (!writer.commit()) return false;
+        reloadCentralDirectory();
+        result.sizeAfter = QFileInfo(archivePath()).size();
+        result.elapsedMs = clock.elapsed();
+        if (op) op->finish();
+        return true;
+    }
+
+    bool exportEntries(const QStringList &names, const QString &destPath, ArchiveOperation *op = nullptr) override {
+        QVector<ZipEntryInfo> entries;
+        qint64 total = 0;
+        for (const QString &name : names) {
+            ZipEntryInfo info;
+            if (!entryInfo(name, info)) return false;
+            entries << info;
+            total += info.compressedSize;
+        }
+        // in archive order, so the source is read front to back
+        std::sort(entries.begin(), entries.end(), [](const ZipEntryInfo &a, const ZipEntryInfo &b) {
+            return a.localHeaderOffset < b.localHeaderOffset;
+        });
+        QScopedPointer<QIODevice> src(openArchiveDevice(archivePath()));
+        ZipRawWriter writer(destPath);
+        if (!src || !writer.open()) return false;
+        if (op) op->begin(entries.size(), total);
+        for (const ZipEntryInfo &e : entries) {
+            if (!writer.copyEntry(*src, e, op)) { writer.cancel(); return false; }
+            if (op) op->advance(0, 1, e.name);
+        }
+        if (!writer.commit()) return false;
+        if (op) op->finish();
+        return true;
+    }
+
+    QIODevice *openEntryDevice(const QString &entry) override {
+        ZipEntryInfo info;
+        if (!entryInfo(entry, info) || !info.isNativelyReadable()) return nullptr;
+        ArchiveEntryDevice *dev = new ArchiveEntryDevice(archivePath(), info);
+        if (!dev->open(QIODevice::ReadOnly)) { delete dev; return nullptr; }
+        return dev;
+    }
+
+    void setExtractOptions(const ExtractOptions &options) {
+        QWriteLocker lock(&m_lock);
+        m_options = options;
+    }
+    ExtractOptions extractOptions() const {
+        QReadLocker lock(&m_lock);
+        return m_options;
+    }
+
+    // copies out the record, so callers on other threads never hold a pointer into the directory
+    bool entryInfo(const QString &entry, ZipEntryInfo &out) const {
+        QReadLocker lock(&m_lock);
+        auto it = m_index.constFind(entry);
+        if (it == m_index.constEnd()) return false;
+        out = m_entries.at(it.value());
+        return true;
+    }
+
+    // empty when the central directory couldn't be parsed
+    QVector<ZipEntryInfo> snapshotEntries() const {
+        QReadLocker lock(&m_lock);
+        return m_cdValid ? m_entries : QVector<ZipEntryInfo>();
+    }
+
+protected:
+    bool hasCentralDirectory() const {
+        QReadLocker lock(&m_lock);
+        return m_cdValid;
+    }
+
+private:
+    // size and modification time: changes whenever zip(1) or an optimize pass rewrites the file
+    QPair<qint64, qint64> fileStamp() const {
+        const QFileInfo fi(archivePath());
+        return qMakePair(fi.size(), fi.lastModified().toMSecsSinceEpoch());
+    }
+
+    void reloadCentralDirectory() {
+        QVector<ZipEntryInfo> entries;
+        QHash<QString, int> index;
+        QScopedPointer<QIODevice> f(openArchiveDevice(archivePath()));
+        const bool valid = f && readZipCentralDirectory(*f, entries);
+        if (valid) {
+            // built before taking the lock so readers aren't blocked while a big directory is indexed
+            index.reserve(entries.size());
+            for (int i = 0; i < entries.size(); ++i) index.insert(entries.at(i).name, i);
+        }
+        QWriteLocker lock(&m_lock);
+        m_cdValid = valid;
+        m_entries.swap(entries);
+        m_index.swap(index);
+    }
+
+    // jobs on the shared scheduler read the directory while the GUI thread may edit the archive
+    mutable QReadWriteLock m_lock;
+    QVector<ZipEntryInfo> m_entries;
+    QHash<QString, int> m_index;
+    bool m_cdValid = false;
+    ExtractOptions m_options;
+    QMutex m_editMutex;   // addFiles, removeEntries and an optimize landing rewrite the file one at a time
+};
+
+// --- Split zip handler ---
+// the native reader already sees a split set as one device; unzip/zip refuse these, so
+// there is no CLI fallback and the set is read-only
+class SplitZipArchiveHandler : public NativeArchiveHandler {
+public:
+    SplitZipArchiveHandler(QObject *parent = nullptr) : NativeArchiveHandler(parent) {}
+
+    static bool handles(const QString &path) { return !MultiVolumeDevice::volumesFor(path).isEmpty(); }
+
+    bool openArchive(const QString &path) override {
+        return NativeArchiveHandler::openArchive(path) && hasCentralDirectory();
+    }
+
+    bool addFiles(const QStringList &, const QString &, ArchiveOperation * = nullptr) override { return false; }
+    bool removeEntries(const QStringList &, ArchiveOperation * = nullptr) override { return false; }
+    bool optimize(int, OptimizeResult &, ArchiveOperation * = nullptr) override { return false; }
+};
+
+// --- Tar family: .tar, .tar.gz/.tgz, .tar.zst/.tzst ---
+// one scan builds a member index plus decompressor checkpoints and keeps it in the cache
+// dir. gzip gets zran-style access points (a deflate block boundary plus the 32 KiB
+// window before it) about every kTarCheckpointSpan bytes of output, zstd gets its frame
+// boundaries. Reopening loads the index, and reading a member restarts the decoder at
+// the last checkpoint before it instead of decompressing everything in front.
+static const qint64 kTarCheckpointSpan = 8 * 1024 * 1024;
+
+struct TarMember {
+    QString name;        // directories end in '/'
+    qint64 offset = 0;   // of the data, in the uncompressed stream
+    qint64 size = 0;
+
+    bool isDir() const { return name.endsWith('/'); }
+};
+
+struct TarCheckpoint {
+    qint64 out = 0;      // uncompressed offset
+    qint64 in = 0;       // compressed offset (gzip: first byte not completely consumed)
+    int bits = 0;        // gzip: bits of byte in - 1 not consumed yet
+    QByteArray window;   // gzip: up to 32 KiB of output preceding the point
+};
+
+struct TarIndex {
+    enum class Kind { Plain, Gzip, Zstd };
+
+    Kind kind = Kind::Plain;
+    qint64 uncompressedSize = 0;
+    QVector<TarMember> members;
+    QVector<TarCheckpoint> checkpoints;   // ascending by out
+
+    static Kind kindFor(const QString &path) {
+        const QString lower = path.toLower();
+        if (lower.endsWith(".tar.gz") || lower.endsWith(".tgz")) return Kind::Gzip;
+        if (lower.endsWith(".tar.zst") || lower.endsWith(".tzst")) return Kind::Zstd;
+        return Kind::Plain;
+    }
+
+    // last checkpoint at or before out, -1 if there is none
+    int checkpointBefore(qint64 out) const {
+        auto it = std::upper_bound(checkpoints.constBegin(), checkpoints.constEnd(), out,
+                                   [](qint64 value, const TarCheckpoint &c) { return value < c.out; });
+        return int(it - checkpoints.constBegin()) - 1;
+    }
+};
+
+// stretch of the uncompressed stream between two checkpoints, decoded by one worker
+struct TarSegment {
+    int checkpoint = -1;     // decoder start, -1 for the top of the file
+    qint64 begin = 0;
+    qint64 end = 0;
+    QVector<int> members;    // indexes of the overlapping members, ascending by offset
+};
+
+// forward-only decoder over the uncompressed tar stream that can start at any checkpoint
+class TarStream {
+public:
+    TarStream(const QString &path, TarIndex::Kind kind) : m_file(path), m_kind(kind), m_inBuf(256 * 1024, Qt::Uninitialized) {}
+    ~TarStream() {
+        endDecoder();
+        if (m_zstd) ZSTD_freeDStream(m_zstd);
+    }
+
+    // scan mode: add a checkpoint to index every kTarCheckpointSpan bytes while decoding from the start
+    void setRecorder(TarIndex *index) { m_record = index; }
+
+    // start decoding at checkpoint cp of index, or at the beginning of the file for cp < 0
+    bool start(const TarIndex *index, int cp) {
+        endDecoder();
+        if (!m_file.isOpen() && !m_file.open(QIODevice::ReadOnly)) return false;
+        const TarCheckpoint *point = index && cp >= 0 ? &index->checkpoints.at(cp) : nullptr;
+        m_out = point ? point->out : 0;
+        m_inBase = point ? point->in : 0;
+        m_inPos = m_inLen = 0;
+        m_skipIn = 0;
+        m_betweenMembers = false;
+        m_started = true;
+        switch (m_kind) {
+        case TarIndex::Kind::Plain:
+            return m_file.seek(m_out);
+        case TarIndex::Kind::Gzip:
+            memset(&m_zs, 0, sizeof(m_zs));
+            // from a checkpoint the stream is raw deflate; from the top, let zlib parse the gzip header
+            m_raw = point != nullptr;
+            if (inflateInit2(&m_zs, m_raw ? -MAX_WBITS : MAX_WBITS + 32) != Z_OK) return false;
+            m_inflating = true;
+            if (!point) return m_file.seek(0);
+            if (point->bits) --m_inBase;
+            if (!m_file.seek(m_inBase)) return false;
+            if (point->bits) {
+                char c;
+                if (!m_file.getChar(&c)) return false;
+                ++m_inBase;
+                inflatePrime(&m_zs, point->bits, uchar(c) >> (8 - point->bits));
+            }
+            if (!point->window.isEmpty()) {
+                inflateSetDictionary(&m_zs, reinterpret_cast<const Bytef*>(point->window.constData()), uInt(point->window.size()));
+            }
+            return true;
+        case TarIndex::Kind::Zstd:
+            if (!m_zstd) m_zstd = ZSTD_createDStream();
+            // checkpoints sit on frame boundaries, so a fresh context can start there
+            return m_zstd && !ZSTD_isError(ZSTD_initDStream(m_zstd)) && m_file.seek(m_inBase);
+        }
+        return false;
+    }
+
+    qint64 pos() const { return m_out; }
+
+    // uncompressed bytes; 0 at the end of the stream, -1 on a decode or read error
+    qint64 read(char *dst, qint64 len) {
+        if (!m_started && !start(nullptr, -1)) return -1;
+        switch (m_kind) {
+        case TarIndex::Kind::Plain: {
+            const qint64 n = m_file.read(dst, len);
+            if (n > 0) m_out += n;
+            return n;
+        }
+        case TarIndex::Kind::Gzip:
+            return readGzip(dst, len);
+        case TarIndex::Kind::Zstd:
+            return readZstd(dst, len);
+        }
+        return -1;
+    }
+
+    // move to uncompressed offset target: restart at a checkpoint when that's closer, then decode forward
+    bool seekTo(const TarIndex *index, qint64 target) {
+        if (m_kind == TarIndex::Kind::Plain) {
+            if (!m_started && !start(nullptr, -1)) return false;
+            if (!m_file.seek(target)) return false;
+            m_out = target;
+            return true;
+        }
+        const int cp = index ? index->checkpointBefore(target) : -1;
+        const bool restart = !m_started || target < m_out || (cp >= 0 && index->checkpoints.at(cp).out > m_out);
+        if (restart && !start(index, cp)) return false;
+        return skip(target - m_out);
+    }
+
+    bool skip(qint64 n) {
+        if (m_kind == TarIndex::Kind::Plain) return seekTo(nullptr, m_out + n);
+        char scratch[65536];
+        while (n > 0) {
+            const qint64 got = read(scratch, qMin<qint64>(sizeof(scratch), n));
+            if (got <= 0) return false;
+            n -= got;
+        }
+        return true;
+    }
+
+private:
+    bool refill() {
+        m_inBase += m_inLen;
+        m_inPos = 0;
+        m_inLen = qMax<qint64>(0, m_file.read(m_inBuf.data(), m_inBuf.size()));
+        return m_inLen > 0;
+    }
+
+    qint64 readGzip(char *dst, qint64 len) {
+        qint64 done = 0;
+        while (done < len) {
+            if (m_inPos == m_inLen && !refill()) break;
+            if (m_skipIn > 0) {
+                // trailer of a member decoded in raw mode; what follows is a new gzip member
+                const qint64 n = qMin(m_skipIn, m_inLen - m_inPos);
+                m_inPos += n;
+                m_skipIn -= n;
+                if (m_skipIn == 0) inflateReset2(&m_zs, MAX_WBITS + 16);
+                continue;
+            }
+            m_zs.next_in = reinterpret_cast<Bytef*>(m_inBuf.data() + m_inPos);
+            m_zs.avail_in = uInt(m_inLen - m_inPos);
+            m_zs.next_out = reinterpret_cast<Bytef*>(dst + done);
+            m_zs.avail_out = uInt(qMin<qint64>(len - done, 1 << 30));
+            const uInt before = m_zs.avail_out;
+            const int rc = inflate(&m_zs, m_record ? Z_BLOCK : Z_NO_FLUSH);
+            m_inPos = m_inLen - m_zs.avail_in;
+            const qint64 produced = before - m_zs.avail_out;
+            done += produced;
+            m_out += produced;
+            if (produced > 0) m_betweenMembers = false;
+            if (rc == Z_STREAM_END) {
+                // concatenated members (pigz, cat a.gz b.gz) continue after the 8-byte trailer
+                if (m_raw) {
+                    m_raw = false;
+                    m_skipIn = 8;
+                } else {
+                    inflateReset(&m_zs);
+                }
+                m_betweenMembers = true;
+                continue;
+            }
+            // trailing garbage or zero padding after the last member ends the stream
+            if (rc == Z_DATA_ERROR && m_betweenMembers) { m_inPos = m_inLen; m_file.seek(m_file.size()); break; }
+            if (rc != Z_OK && rc != Z_BUF_ERROR) return -1;
+            if (m_record && (m_zs.data_type & 128) && !(m_zs.data_type & 64)
+                && (m_record->checkpoints.isEmpty() || m_out - m_record->checkpoints.last().out >= kTarCheckpointSpan)) {
+                TarCheckpoint c;
+                c.out = m_out;
+                c.in = m_inBase + m_inPos;
+                c.bits = m_zs.data_type & 7;
+                c.window.resize(32768);
+                uInt windowLen = uInt(c.window.size());
+                inflateGetDictionary(&m_zs, reinterpret_cast<Bytef*>(c.window.data()), &windowLen);
+                c.window.resize(int(windowLen));
+                m_record->checkpoints << c;
+            }
+        }
+        return done;
+    }
+
+    qint64 readZstd(char *dst, qint64 len) {
+        qint64 done = 0;
+        while (done < len) {
+            ZSTD_inBuffer in = { m_inBuf.constData(), size_t(m_inLen), size_t(m_inPos) };
+            ZSTD_outBuffer out = { dst + done, size_t(len - done), 0 };
+            const size_t ret = ZSTD_decompressStream(m_zstd, &out, &in);
+            if (ZSTD_isError(ret)) return -1;
+            m_inPos = qint64(in.pos);
+            done += qint64(out.pos);
+            m_out += qint64(out.pos);
+            // 0: a frame just ended, so the next one is an independent starting point
+            if (ret == 0 && m_record
+                && (m_record->checkpoints.isEmpty() || m_out - m_record->checkpoints.last().out >= kTarCheckpointSpan)) {
+                TarCheckpoint c;
+                c.out = m_out;
+                c.in = m_inBase + m_inPos;
+                m_record->checkpoints << c;
+            }
+            if (out.pos == 0 && m_inPos == m_inLen && !refill()) break;
+        }
+        return done;
+    }
+
+    void endDecoder() {
+        if (m_inflating) inflateEnd(&m_zs);
+        m_inflating = false;
+    }
+
+    QFile m_file;
+    const TarIndex::Kind m_kind;
+    TarIndex *m_record = nullptr;
+    QByteArray m_inBuf;
+    qint64 m_inBase = 0;   // file offset of m_inBuf[0]
+    qint64 m_inPos = 0;
+    qint64 m_inLen = 0;
+    qint64 m_out = 0;
+    qint64 m_skipIn = 0;
+    bool m_started = false;
+    bool m_raw = false;
+    bool m_betweenMembers = false;
+    z_stream m_zs;
+    bool m_inflating = false;
+    ZSTD_DStream *m_zstd = nullptr;
+};
+
+// octal, or GNU base-256 when the top bit of the first byte is set
+static qint64 parseTarNumber(const char *field, int len) {
+    qint64 v = 0;
+    if (uchar(field[0]) & 0x80) {
+        for (int i = 1; i < len; ++i) v = (v << 8) | uchar(field[i]);
+        return v;
+    }
+    for (int i = 0; i < len && field[i]; ++i) {
+        if (field[i] >= '0' && field[i] <= '7') v = v * 8 + (field[i] - '0');
+    }
+    return v;
+}
+
+// one pass over the archive: headers become members, compressed tars also get checkpoints
+static bool scanTarArchive(const QString &path, TarIndex &index) {
+    index = TarIndex();
+    index.kind = TarIndex::kindFor(path);
+    TarStream s(path, index.kind);
+    if (index.kind != TarIndex::Kind::Plain) s.setRecorder(&index);
+    if (!s.start(nullptr, -1)) return false;
+
+    QString longName, paxPath;
+    qint64 paxSize = -1;
+    // only an archive read up to its end marker (two zero blocks) gives an index; a truncated or
+    // damaged one fails instead of being listed, and cached, as if its first members were all of it
+    char h[512];
+    for (;;) {
+        if (s.read(h, sizeof(h)) != qint64(sizeof(h))) return false;
+        if (isAllZero(h, sizeof(h))) {
+            if (s.read(h, sizeof(h)) != qint64(sizeof(h)) || !isAllZero(h, sizeof(h))) return false;
+            break;
+        }
+        // header checksum: sum of all bytes with the checksum field itself counted as spaces
+        qint64 sum = 0;
+        for (int i = 0; i < 512; ++i) sum += (i >= 148 && i < 156) ? ' ' : uchar(h[i]);
+        if (sum != parseTarNumber(h + 148, 8)) return false;
+
+        const char type = h[156];
+        qint64 size = parseTarNumber(h + 124, 12);
+        QByteArray rawName(h, int(qstrnlen(h, 100)));
+        if (memcmp(h + 257, "ustar", 5) == 0 && h[345]) rawName = QByteArray(h + 345, int(qstrnlen(h + 345, 155))) + '/' + rawName;
+
+        if (type == 'L' || type == 'x' || type == 'K' || type == 'g') {
+            // metadata for the next header: GNU long name, pax attributes, long link name
+            if (size > 1024 * 1024) return false;
+            QByteArray meta(int(size), Qt::Uninitialized);
+            if (s.read(meta.data(), size) != size || !s.skip(((size + 511) & ~qint64(511)) - size)) return false;
+            if (type == 'L') longName = QString::fromUtf8(meta.constData());
+            if (type == 'x') {
+                // records are "<len> <key>=<value>\n"
+                for (int at = 0; at < meta.size(); ) {
+                    const int space = meta.indexOf(' ', at);
+                    const int recLen = space > at ? meta.mid(at, space - at).toInt() : 0;
+                    if (recLen <= 0 || at + recLen > meta.size()) break;
+                    const QByteArray rec = meta.mid(space + 1, at + recLen - space - 2);
+                    if (rec.startsWith("path=")) paxPath = QString::fromUtf8(rec.mid(5));
+                    else if (rec.startsWith("size=")) paxSize = rec.mid(5).toLongLong();
+                    at += recLen;
+                }
+            }
+            continue;
+        }
+
+        TarMember m;
+        m.name = !paxPath.isEmpty() ? paxPath : !longName.isEmpty() ? longName : QString::fromUtf8(rawName);
+        if (paxSize >= 0) size = paxSize;
+        m.offset = s.pos();
+        m.size = size;
+        paxPath.clear();
+        longName.clear();
+        paxSize = -1;
+        if (type == '5') {
+            if (!m.name.endsWith('/')) m.name += '/';
+            m.size = 0;
+            index.members << m;
+        } else if (type == '0' || type == '\0' || type == '7') {
+            index.members << m;
+        }
+        // links, devices and fifos have no data worth extracting here
+        if (!s.skip((size + 511) & ~qint64(511))) return false;
+    }
+    index.uncompressedSize = s.pos();
+    return true;
+}
+
+// index files live in the cache dir, keyed by the archive's absolute path and invalidated by size/mtime
+static QString tarIndexPath(const QString &archivePath) {
+    const QByteArray key = QFileInfo(archivePath).absoluteFilePath().toUtf8();
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/tar-index/"
+         + QCryptographicHash::hash(key, QCryptographicHash::Sha1).toHex() + ".idx";
+}
+
+static const quint32 kTarIndexMagic = 0x5a544958;   // "ZTIX"
+static const quint32 kTarIndexVersion = 1;
+
+static bool saveTarIndex(const QString &archivePath, const TarIndex &index) {
+    const QString path = tarIndexPath(archivePath);
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    QSaveFile f(path);
+    if (!f.open(QIODevice::WriteOnly)) return false;
+    const QFileInfo fi(archivePath);
+    QDataStream out(&f);
+    out.setVersion(QDataStream::Qt_5_12);
+    out << kTarIndexMagic << kTarIndexVersion << qint64(fi.size()) << qint64(fi.lastModified().toMSecsSinceEpoch())
+        << qint32(index.kind) << index.uncompressedSize << quint32(index.members.size());
+    for (const TarMember &m : index.members) out << m.name << m.offset << m.size;
+    out << quint32(index.checkpoints.size());
+    // windows are mostly text from the archive and shrink a lot
+    for (const TarCheckpoint &c : index.checkpoints) out << c.out << c.in << qint32(c.bits) << qCompress(c.window);
+    return out.status() == QDataStream::Ok && f.commit();
+}
+
+static bool loadTarIndex(const QString &archivePath, TarIndex &index) {
+    QFile f(tarIndexPath(archivePath));
+    if (!f.open(QIODevice::ReadOnly)) return false;
+    const QFileInfo fi(archivePath);
+    QDataStream in(&f);
+    in.setVersion(QDataStream::Qt_5_12);
+    quint32 magic = 0, version = 0, memberCount = 0, checkpointCount = 0;
+    qint64 size = 0, mtime = 0;
+    qint32 kind = 0;
+    in >> magic >> version >> size >> mtime >> kind;
+    if (magic != kTarIndexMagic || version != kTarIndexVersion || size != fi.size()
+        || mtime != fi.lastModified().toMSecsSinceEpoch() || kind != qint32(TarIndex::kindFor(archivePath))) return false;
+    index = TarIndex();
+    index.kind = TarIndex::Kind(kind);
+    in >> index.uncompressedSize >> memberCount;
+    index.members.reserve(int(memberCount));
+    for (quint32 i = 0; i < memberCount && in.status() == QDataStream::Ok; ++i) {
+        TarMember m;
+        in >> m.name >> m.offset >> m.size;
+        index.members << m;
+    }
+    in >> checkpointCount;
+    index.checkpoints.reserve(int(checkpointCount));
+    for (quint32 i = 0; i < checkpointCount && in.status() == QDataStream::Ok; ++i) {
+        TarCheckpoint c;
+        qint32 bits = 0;
+        QByteArray window;
+        in >> c.out >> c.in >> bits >> window;
+        c.bits = bits;
+        c.window = qUncompress(window);
+        index.checkpoints << c;
+    }
+    return in.status() == QDataStream::Ok;
+}
+
+class TarArchiveHandler : public CliArchiveHandler {
+public:
+    TarArchiveHandler(QObject *parent = nullptr) : CliArchiveHandler(parent) {}
+
+    static bool handles(const QString &path) {
+        const QString lower = path.toLower();
+        return lower.endsWith(".tar") || TarIndex::kindFor(path) != TarIndex::Kind::Plain;
+    }
+
+    bool openArchive(const QString &path) override {
+        if (!CliArchiveHandler::openArchive(path)) return false;
+        return reloadIndex();
+    }
+
+    QStringList listEntries(const QString &prefix = QString()) const override {
+        QStringList entries;
+        for (const TarMember &m : index()->members) {
+            if (prefix.isEmpty() || m.name.startsWith(prefix)) entries << m.name;
+        }
+        return entries;
+    }
+
+    bool extractEntryToTemp(const QString &entry, QString &outPath) override {
+        const QSharedPointer<const TarIndex> idx = index();
+        TarMember m;
+        if (!findMember(entry, m) || !isSafeEntryPath(entry)) return false;
+        const QString tmp = QDir::temp().filePath(QString("qt_arch_tmp_%1").arg(QUuid::createUuid().toString()));
+        if (!extractMembers(idx, {m}, tmp, nullptr)) return false;
+        outPath = QDir(tmp).filePath(entry);
+        return true;
+    }
+
+    bool extractAll(const QString &destDir, ArchiveOperation *op = nullptr) override {
+        const QSharedPointer<const TarIndex> idx = index();
+        return extractMembers(idx, idx->members, destDir, op);
+    }
+
+    bool extractEntries(const QStringList &names, const QString &destDir, ArchiveOperation *op = nullptr) override {
+        QVector<TarMember> members;
+        for (const QString &name : names) {
+            TarMember m;
+            if (!findMember(name, m)) return false;
+            members << m;
+        }
+        return extractMembers(index(), members, destDir, op);
+    }
+
+    // a compressed tar can't be appended to or edited in place, a plain one goes through tar(1)
+    bool addFiles(const QStringList &files, const QString &, ArchiveOperation *op = nullptr) override {
+        if (TarIndex::kindFor(archivePath()) != TarIndex::Kind::Plain) return false;
+        QStringList args{"-rf", archivePath()};
+        for (const QString &f : files) args << "-C" << QFileInfo(f).absolutePath() << QFileInfo(f).fileName();
+        if (op) op->begin(files.size(), 0);
+        const bool ok = runTool("tar", args, op, nullptr);
+        reloadIndex();
+        if (ok && op) op->finish();
+        return ok;
+    }
+
+    bool removeEntries(const QStringList &entries, ArchiveOperation *op = nullptr) override {
+        if (TarIndex::kindFor(archivePath()) != TarIndex::Kind::Plain) return false;
+        if (op) op->begin(entries.size(), 0);
+        const bool ok = runTool("tar", QStringList{"--delete", "-f", archivePath()} + entries, op, nullptr);
+        reloadIndex();
+        if (ok && op) op->finish();
+        return ok;
+    }
+
+    void setPassword(const QString &) override {}
+
+private:
+    bool reloadIndex() {
+        QSharedPointer<TarIndex> idx(new TarIndex);
+        if (!loadTarIndex(archivePath(), *idx)) {
+            if (!scanTarArchive(archivePath(), *idx)) return false;
+            saveTarIndex(archivePath(), *idx);   // best effort: without it the next open just scans again
+        }
+        QHash<QString, int> byName;
+        byName.reserve(idx->members.size());
+        for (int i = 0; i < idx->members.size(); ++i) byName.insert(idx->members.at(i).name, i);
+        QWriteLocker lock(&m_lock);
+        m_index = idx;
+        m_byName.swap(byName);
+        return true;
+    }
+
+    QSharedPointer<const TarIndex> index() const {
+        QReadLocker lock(&m_lock);
+        return m_index ? m_index : QSharedPointer<const TarIndex>(new TarIndex);
+    }
+
+    bool findMember(const QString &name, TarMember &out) const {
+        QReadLocker lock(&m_lock);
+        auto it = m_byName.constFind(name);
+        if (!m_index || it == m_byName.constEnd()) return false;
+        out = m_index->members.at(it.value());
+        return true;
+    }
+
+    bool extractMembers(const QSharedPointer<const TarIndex> &idx, QVector<TarMember> members, const QString &destDir,
+                        ArchiveOperation *op) {
+        std::sort(members.begin(), members.end(), [](const TarMember &a, const TarMember &b) { return a.offset < b.offset; });
+        qint64 total = 0;
+        for (const TarMember &m : members) {
+            if (!isSafeEntryPath(m.name)) return false;
+            total += m.size;
+        }
+        if (op) op->begin(members.size(), total);
+        // every checkpoint is an independent starting point, so a compressed tar with more than one can be split up
+        if (idx->kind != TarIndex::Kind::Plain && !idx->checkpoints.isEmpty() && QThread::idealThreadCount() > 1) {
+            return extractMembersParallel(idx, members, destDir, op);
+        }
+        return extractMembersSequential(idx, members, destDir, op);
+    }
+
+    // members in stream order through one decoder, which jumps ahead via checkpoints where it can
+    bool extractMembersSequential(const QSharedPointer<const TarIndex> &idx, const QVector<TarMember> &members,
+                                  const QString &destDir, ArchiveOperation *op) {
+        const QDir dest(destDir);
+        TarStream s(archivePath(), idx->kind);
+        QByteArray buf(256 * 1024, Qt::Uninitialized);
+        for (const TarMember &m : members) {
+            if (op && op->isCancelled()) return false;
+            const QString outPath = dest.filePath(m.name);
+            if (m.isDir()) {
+                QDir().mkpath(outPath);
+                if (op) op->advance(0, 1, m.name);
+                continue;
+            }
+            QDir().mkpath(QFileInfo(outPath).absolutePath());
+            QFile out(outPath);
+            bool ok = s.seekTo(idx.data(), m.offset) && out.open(QIODevice::WriteOnly | QIODevice::Truncate);
+            for (qint64 left = m.size; ok && left > 0; ) {
+                if (op && op->isCancelled()) { ok = false; break; }
+                const qint64 n = s.read(buf.data(), qMin<qint64>(buf.size(), left));
+                ok = n > 0 && out.write(buf.constData(), n) == n;
+                left -= n;
+                if (ok && op) op->advance(n);
+            }
+            if (!ok) {
+                out.close();
+                out.remove();
+                return false;
+            }
+            if (op) op->advance(0, 1, m.name);
+        }
+        if (op) op->finish();
+        return true;
+    }
+
+    // the stream is cut at the checkpoints into segments that workers decode independently,
+    // each writing the parts of members that fall inside its segment at their file offsets.
+    // A member spanning several segments is closed by whichever worker finishes its last part.
+    bool extractMembersParallel(const QSharedPointer<const TarIndex> &idx, const QVector<TarMember> &members,
+                                const QString &destDir, ArchiveOperation *op) {
+        const QDir dest(destDir);
+        const QVector<TarCheckpoint> &cps = idx->checkpoints;
+
+        // directories and empty files need no decoding; everything else gets a part per overlapped segment
+        QMap<int, TarSegment> needed;
+        QVector<int> remaining(members.size(), 0);
+        for (int i = 0; i < members.size(); ++i) {
+            const TarMember &m = members.at(i);
+            const QString outPath = dest.filePath(m.name);
+            if (m.isDir()) {
+                QDir().mkpath(outPath);
+                if (op) op->advance(0, 1, m.name);
+                continue;
+            }
+            QDir().mkpath(QFileInfo(outPath).absolutePath());
+            if (m.size == 0) {
+                QFile out(outPath);
+                if (!out.open(QIODevice::WriteOnly | QIODevice::Truncate)) return false;
+                if (op) op->advance(0, 1, m.name);
+                continue;
+            }
+            const int first = idx->checkpointBefore(m.offset) + 1;
+            const int last = idx->checkpointBefore(m.offset + m.size - 1) + 1;
+            for (int si = first; si <= last; ++si) {
+                auto it = needed.find(si);
+                if (it == needed.end()) {
+                    TarSegment seg;
+                    seg.checkpoint = si - 1;
+                    seg.begin = si > 0 ? cps.at(si - 1).out : 0;
+                    seg.end = si < cps.size() ? cps.at(si).out : idx->uncompressedSize;
+                    it = needed.insert(si, seg);
+                }
+                it->members << i;
+            }
+            remaining[i] = last - first + 1;
+        }
+        const QVector<TarSegment> segments = QVector<TarSegment>::fromList(needed.values());
+
+        QScopedPointer<IoEngine> io(IoEngine::create());
+        QMutex fileMutex;
+        QVector<int> handles(members.size(), -1);
+        QAtomicInt next(0);
+        QAtomicInt failed(0);
+        const QString path = archivePath();
+
+        auto handleFor = [&](int mi) {
+            QMutexLocker lock(&fileMutex);
+            if (handles.at(mi) < 0) handles[mi] = io->open(dest.filePath(members.at(mi).name));
+            return handles.at(mi);
+        };
+        auto finishPart = [&](int mi) {
+            QMutexLocker lock(&fileMutex);
+            if (--remaining[mi] > 0) return;
+            const int handle = handles.at(mi);
+            handles[mi] = -1;
+            lock.unlock();
+            io->close(handle, true);
+            if (op) op->advance(0, 1, members.at(mi).name);
+        };
+        auto work = [&]() {
+            TarStream s(path, idx->kind);
+            QByteArray buf(1024 * 1024, Qt::Uninitialized);
+            for (;;) {
+                const int si = next.fetchAndAddRelaxed(1);
+                if (si >= segments.size() || failed.load() || (op && op->isCancelled())) return;
+                const TarSegment &seg = segments.at(si);
+                const TarMember &lastMember = members.at(seg.members.last());
+                const qint64 stop = qMin(seg.end, lastMember.offset + lastMember.size);
+                if (!s.start(idx.data(), seg.checkpoint)) { failed.store(1); return; }
+                int firstOpen = 0;   // members before this one are done with this segment
+                while (s.pos() < stop) {
+                    if (op && op->isCancelled()) return;
+                    const qint64 chunkBegin = s.pos();
+                    const qint64 n = s.read(buf.data(), qMin<qint64>(buf.size(), stop - chunkBegin));
+                    if (n <= 0) { failed.store(1); return; }
+                    const qint64 chunkEnd = chunkBegin + n;
+                    for (int k = firstOpen; k < seg.members.size(); ++k) {
+                        const int mi = seg.members.at(k);
+                        const TarMember &m = members.at(mi);
+                        if (m.offset >= chunkEnd) break;
+                        const qint64 a = qMax(m.offset, chunkBegin);
+                        const qint64 b = qMin(m.offset + m.size, chunkEnd);
+                        if (a >= b) {
+                            if (k == firstOpen) ++firstOpen;
+                            continue;
+                        }
+                        const int handle = handleFor(mi);
+                        if (handle < 0 || !io->write(handle, a - m.offset, QByteArray(buf.constData() + (a - chunkBegin), int(b - a)))) {
+                            failed.store(1);
+                            return;
+                        }
+                        if (op) op->advance(b - a);
+                    }
+                }
+                for (int mi : seg.members) finishPart(mi);
+            }
+        };
+
+        QThreadPool workers;
+        const int threads = qMin(qMax(1, QThread::idealThreadCount()), segments.size());
+        workers.setMaxThreadCount(qMax(1, threads));
+        for (int t = 0; t < threads; ++t) workers.start(new FunctionRunnable(work));
+        workers.waitForDone();
+
+        const bool ok = !failed.load() && !(op && op->isCancelled());
+        // members left half-written by a failure or cancel are removed
+        for (int mi = 0; mi < handles.size(); ++mi) {
+            if (handles.at(mi) >= 0) io->close(handles.at(mi), false);
+        }
+        if (!io->flush() || !ok) return false;
+        if (op) op->finish();
+        return true;
+    }
+
+    mutable QReadWriteLock m_lock;
+    QSharedPointer<const TarIndex> m_index;
+    QHash<QString, int> m_byName;
+};
+
+// --- Native .vfsarc container ---
+// layout, all integers little-endian:
+//   header   kVfsHeaderSize bytes: magic, version, chunk size, flags and, when encrypted,
+//            the key derivation salt, iteration count and a key check value
+//   chunks   entry payloads cut into chunks of at most chunkSize, each zstd-compressed on its
+//            own (or stored when that doesn't shrink it), so any chunk decodes without its
+//            neighbours. With kVfsFlagDedup the cuts are content-defined and a chunk whose
+//            bytes are already in the archive is referenced instead of stored again. With
+//            kVfsFlagEncrypted every stored chunk is sealed on its own with AES-256-GCM, so
+//            any chunk decrypts and authenticates without its neighbours too.
+//   index    fixed-size entry and chunk records (plus chunk digests when deduplicating), the
+//            list of chunks each entry references, a perfect-hash table over the names, the
+//            name pool, the manifest JSON and the zstd dictionary small entries are packed with
+//   log      edits made since the index was written. Each one appends its new chunks, then a
+//            record with the added entries (chunk records inline), tombstones and optionally
+//            a new manifest or the archive's first dictionary, linked to the record before it
+//   trailer  kVfsTrailerSize bytes pointing at the index and the newest log record. An edit
+//            exists once its trailer is synced; a torn append is ignored on open.
+// The index is used in place from the mapping: opening costs one mmap and a crc over the
+// index, a name lookup is O(1), and the chunk holding byte n of an entry is found from the
+// raw sizes of the chunks before it.
+// The log is replayed into a small overlay that shadows the index. Chunks nothing refers to
+// any more are counted in the trailer; compaction rewrites the archive once they dominate.
+static const char kVfsMagic[8] = {'V', 'F', 'S', 'A', 'R', 'C', '\r', '\n'};
+static const char kVfsTrailerMagic[8] = {'V', 'F', 'S', 'I', 'N', 'D', 'E', 'X'};
+static const char kVfsLogMagic[8] = {'V', 'F', 'S', 'L', 'O', 'G', '\r', '\n'};
+static const quint32 kVfsVersion = 3;
+static const int kVfsHeaderSize = 64;
+static const int kVfsTrailerSize = 64;
+static const int kVfsIndexHeaderSize = 48;
+static const int kVfsEntryRecordSize = 48;
+static const int kVfsChunkRecordSize = 24;
+static const int kVfsDigestSize = 32;
+static const int kVfsLogHeaderSize = 48;
+static const int kVfsLogEntrySize = 32;
+static const quint32 kVfsChunkSize = 256 * 1024;
+static const quint32 kVfsMinChunkSize = 64 * 1024;          // bounds accepted from a header
+static const quint32 kVfsMaxChunkSize = 64 * 1024 * 1024;
+static const quint32 kVfsNoEntry = 0xFFFFFFFF;
+static const quint32 kVfsEntryDir = 0x1;
+static const quint32 kVfsFlagDedup = 0x1;
+static const quint32 kVfsFlagEncrypted = 0x2;
+static const int kVfsSaltSize = 16;
+static const int kVfsKeySize = 32;
+static const int kVfsNonceSize = 12;
+static const int kVfsTagSize = 16;
+static const quint32 kVfsKdfIterations = 200000;
+static const int kVfsZstdLevel = 3;
+static const int kVfsZstdFastLevel = 1;
+static const int kVfsZstdStrongLevel = 9;
+static const int kVfsSniffSize = 64 * 1024;             // bytes looked at to pick a level
+static const int kVfsDictSize = 64 * 1024;
+static const qint64 kVfsDictMaxEntry = 32 * 1024;       // entries up to this size use the dictionary
+static const int kVfsDictMinSamples = 64;
+static const qint64 kVfsDictSampleBytes = 8 * 1024 * 1024;
+static const double kVfsCompactRatio = 0.4;
+static const qint64 kVfsCompactMinGarbage = 16 * 1024 * 1024;
+
+struct VfsChunk {
+    enum Method { Stored = 0, Zstd = 1, ZstdDict = 2 };
+
+    qint64 offset = 0;
+    quint32 storedSize = 0;
+    quint32 rawSize = 0;
+    quint32 method = Stored;
+    quint32 crc = 0;         // of the raw bytes
+    QByteArray digest;       // of the raw bytes, kept only by deduplicating archives
+
+    static VfsChunk decode(const char *r) {
+        VfsChunk c;
+        c.offset = qint64(qFromLittleEndian<quint64>(r));
+        c.storedSize = qFromLittleEndian<quint32>(r + 8);
+        c.rawSize = qFromLittleEndian<quint32>(r + 12);
+        c.method = qFromLittleEndian<quint32>(r + 16);
+        c.crc = qFromLittleEndian<quint32>(r + 20);
+        return c;
+    }
+    void appendTo(QByteArray &out) const {
+        char r[kVfsChunkRecordSize] = {};
+        qToLittleEndian<quint64>(quint64(offset), r);
+        qToLittleEndian<quint32>(storedSize, r + 8);
+        qToLittleEndian<quint32>(rawSize, r + 12);
+        qToLittleEndian<quint32>(method, r + 16);
+        qToLittleEndian<quint32>(crc, r + 20);
+        out.append(r, sizeof(r));
+    }
+};
+
+struct VfsTrailer {
+    qint64 indexOffset = 0;
+    qint64 indexSize = 0;
+    quint32 indexCrc = 0;
+    qint64 logOffset = 0;    // newest log record, 0 while there is none
+    qint64 logSize = 0;
+    qint64 garbage = 0;      // stored bytes of chunks no live entry refers to
+
+    QByteArray encode() const {
+        QByteArray t(kVfsTrailerSize, '\0');
+        memcpy(t.data(), kVfsTrailerMagic, sizeof(kVfsTrailerMagic));
+        qToLittleEndian<quint64>(quint64(indexOffset), t.data() + 8);
+        qToLittleEndian<quint64>(quint64(indexSize), t.data() + 16);
+        qToLittleEndian<quint32>(indexCrc, t.data() + 24);
+        qToLittleEndian<quint64>(quint64(logOffset), t.data() + 32);
+        qToLittleEndian<quint64>(quint64(logSize), t.data() + 40);
+        qToLittleEndian<quint64>(quint64(garbage), t.data() + 48);
+        qToLittleEndian<quint32>(quint32(crc32(0, reinterpret_cast<const Bytef*>(t.constData()), 56)), t.data() + 56);
+        return t;
+    }
+    // t is kVfsTrailerSize bytes found at offset at
+    bool decode(const char *t, qint64 at) {
+        if (memcmp(t, kVfsTrailerMagic, sizeof(kVfsTrailerMagic)) != 0
+            || qFromLittleEndian<quint32>(t + 56) != quint32(crc32(0, reinterpret_cast<const Bytef*>(t), 56))) return false;
+        indexOffset = qint64(qFromLittleEndian<quint64>(t + 8));
+        indexSize = qint64(qFromLittleEndian<quint64>(t + 16));
+        indexCrc = qFromLittleEndian<quint32>(t + 24);
+        logOffset = qint64(qFromLittleEndian<quint64>(t + 32));
+        logSize = qint64(qFromLittleEndian<quint64>(t + 40));
+        garbage = qint64(qFromLittleEndian<quint64>(t + 48));
+        return indexOffset >= kVfsHeaderSize && indexSize >= kVfsIndexHeaderSize && indexOffset + indexSize <= at
+            && logOffset >= 0 && logSize >= 0 && logOffset + logSize <= at;
+    }
+};
+
+static qint64 vfsAlign8(qint64 v) { return (v + 7) & ~qint64(7); }
+
+// payloads that are compressed already: media, nested archives and compressed streams
+static bool isCompressedFormat(const char *p, int n) {
+    auto starts = [p, n](const char *magic, int len, int at) { return n >= at + len && memcmp(p + at, magic, size_t(len)) == 0; };
+    return starts("\xFF\xD8\xFF", 3, 0)  // jpeg
+        || starts("\x89PNG\r\n\x1A\n", 8, 0) || starts("GIF8", 4, 0)
+        || (starts("RIFF", 4, 0) && (starts("WEBP", 4, 8) || starts("AVI ", 4, 8)))
+        || starts("ftyp", 4, 4)  // mp4, mov, m4a, heic
+        || starts("\x1A\x45\xDF\xA3", 4, 0)  // mkv, webm
+        || starts("ID3", 3, 0) || starts("\xFF\xFB", 2, 0) || starts("OggS", 4, 0) || starts("fLaC", 4, 0)
+        || starts("PK\x03\x04", 4, 0) || starts("\x1F\x8B", 2, 0) || starts("\x28\xB5\x2F\xFD", 4, 0)
+        || starts("\xFD" "7zXZ\x00", 6, 0) || starts("BZh", 3, 0) || starts("7z\xBC\xAF\x27\x1C", 6, 0)
+        || starts("Rar!\x1A\x07", 6, 0) || starts(kVfsMagic, int(sizeof(kVfsMagic)), 0);
+}
+
+// zstd level for a payload, judged from its first bytes: 0 to store it as is. Known compressed
+// formats and near-random bytes (order-0 entropy close to 8 bits per byte) aren't worth a
+// compression attempt; the more redundant the data, the more a stronger level pays back.
+static int vfsChooseLevel(const char *p, int n) {
+    n = qMin(n, kVfsSniffSize);
+    if (n == 0) return kVfsZstdLevel;
+    if (isCompressedFormat(p, n)) return 0;
+    quint32 counts[256] = {};
+    for (int i = 0; i < n; ++i) ++counts[uchar(p[i])];
+    double bits = 0;
+    for (quint32 count : counts) {
+        if (count) bits -= double(count) / n * std::log2(double(count) / n);
+    }
+    if (bits >= 7.6) return 0;
+    if (bits >= 7.0) return kVfsZstdFastLevel;
+    if (bits <= 5.0) return kVfsZstdStrongLevel;
+    return kVfsZstdLevel;
+}
+
+// zstd at the given level when that saves anything, stored otherwise; level 0 stores without
+// trying. out receives the bytes to write. The crc is the caller's, it is computed alongside the digest.
+static void encodeVfsChunk(ZSTD_CCtx *cctx, const char *data, quint32 n, VfsChunk &c, QByteArray &out,
+                           const ZSTD_CDict *dict = nullptr, int level = kVfsZstdLevel) {
+    c.rawSize = n;
+    size_t z = n;
+    if (level > 0) {
+        out.resize(int(ZSTD_compressBound(n)));
+        z = dict ? ZSTD_compress_usingCDict(cctx, out.data(), size_t(out.size()), data, n, dict)
+                 : ZSTD_compressCCtx(cctx, out.data(), size_t(out.size()), data, n, level);
+    }
+    if (!ZSTD_isError(z) && z < n) {
+        c.method = dict ? VfsChunk::ZstdDict : VfsChunk::Zstd;
+        c.storedSize = quint32(z);
+        out.resize(int(z));
+    } else {
+        c.method = VfsChunk::Stored;
+        c.storedSize = n;
+        out = QByteArray(data, int(n));
+    }
+}
+
+// flush and, where there is an fd, fsync
+static bool syncVfsFile(QFileDevice &f) {
+    if (!f.flush()) return false;
+#ifdef Q_OS_UNIX
+    return ::fsync(f.handle()) == 0;
+#else
+    return true;
+#endif
+}
+
+// key of an encrypted archive: PBKDF2-HMAC-SHA256 over the password, with the salt and iteration
+// count from the header. Deriving is deliberately slow, so it happens once per password.
+struct VfsKey {
+    QByteArray salt;
+    quint32 iterations = 0;
+    QByteArray key;
+
+    bool isNull() const { return key.isEmpty(); }
+    bool operator==(const VfsKey &o) const { return key == o.key; }
+    bool operator!=(const VfsKey &o) const { return key != o.key; }
+
+    static VfsKey derive(const QString &password, const QByteArray &salt, quint32 iterations) {
+        VfsKey k;
+        const QByteArray pw = password.toUtf8();
+        QByteArray key(kVfsKeySize, '\0');
+        if (salt.size() != kVfsSaltSize || iterations == 0
+            || PKCS5_PBKDF2_HMAC(pw.constData(), pw.size(), reinterpret_cast<const unsigned char*>(salt.constData()), salt.size(),
+                                 int(iterations), EVP_sha256(), key.size(), reinterpret_cast<unsigned char*>(key.data())) != 1) return k;
+        k.salt = salt;
+        k.iterations = iterations;
+        k.key = key;
+        return k;
+    }
+
+    // a new archive gets a fresh salt
+    static VfsKey create(const QString &password) {
+        QByteArray salt(kVfsSaltSize, '\0');
+        if (RAND_bytes(reinterpret_cast<unsigned char*>(salt.data()), salt.size()) != 1) return VfsKey();
+        return derive(password, salt, kVfsKdfIterations);
+    }
+
+    // stored in the header so a wrong password is told apart from a damaged chunk
+    QByteArray checkValue() const;
+
+    // chunk digests of an encrypted archive are keyed, so equal digests reveal nothing to
+    // someone without the password
+    QByteArray digestKey() const {
+        return key.isEmpty() ? QByteArray() : QCryptographicHash::hash("VFSARC digest" + key, QCryptographicHash::Sha256);
+    }
+};
+
+// AES-256-GCM over in, with aad authenticated alongside; tag is kVfsTagSize bytes, written when
+// sealing and checked when opening
+static bool vfsGcm(bool seal, const QByteArray &key, const char *nonce, const QByteArray &aad,
+                   const char *in, int n, char *out, char *tag) {
+    EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+    if (!ctx) return false;
+    const unsigned char *ukey = reinterpret_cast<const unsigned char*>(key.constData());
+    const unsigned char *unonce = reinterpret_cast<const unsigned char*>(nonce);
+    unsigned char tail[16];
+    int len = 0;
+    bool ok = key.size() == kVfsKeySize
+        && EVP_CipherInit_ex(ctx, EVP_aes_256_gcm(), nullptr, nullptr, nullptr, seal ? 1 : 0) == 1
+        && EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_IVLEN, kVfsNonceSize, nullptr) == 1
+        && EVP_CipherInit_ex(ctx, nullptr, nullptr, ukey, unonce, seal ? 1 : 0) == 1
+        && EVP_CipherUpdate(ctx, nullptr, &len, reinterpret_cast<const unsigned char*>(aad.constData()), aad.size()) == 1
+        && (n == 0 || EVP_CipherUpdate(ctx, reinterpret_cast<unsigned char*>(out), &len,
+                                       reinterpret_cast<const unsigned char*>(in), n) == 1);
+    if (ok && !seal) ok = EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_TAG, kVfsTagSize, tag) == 1;
+    ok = ok && EVP_CipherFinal_ex(ctx, tail, &len) == 1;
+    if (ok && seal) ok = EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG, kVfsTagSize, tag) == 1;
+    EVP_CIPHER_CTX_free(ctx);
+    return ok;
+}
+
+QByteArray VfsKey::checkValue() const {
+    const char nonce[kVfsNonceSize] = {};
+    char tag[kVfsTagSize];
+    if (!vfsGcm(true, key, nonce, QByteArray("VFSARC key check"), nullptr, 0, nullptr, tag)) return QByteArray();
+    return QByteArray(tag, kVfsTagSize);
+}
+
+// the chunk's method and raw size are authenticated with it, so a tampered record can't make a
+// reader decode the plaintext as something else
+static QByteArray vfsChunkAad(const VfsChunk &c) {
+    char aad[8];
+    qToLittleEndian<quint32>(c.method, aad);
+    qToLittleEndian<quint32>(c.rawSize, aad + 4);
+    return QByteArray(aad, sizeof(aad));
+}
+
+// stored bytes become nonce || ciphertext || tag. The nonce is random rather than derived from
+// the chunk's position: a torn append or a compaction writes new chunks where old ones were
+// under the same key, and a GCM nonce must never repeat.
+static bool sealVfsChunk(const QByteArray &key, VfsChunk &c, QByteArray &stored) {
+    QByteArray sealed(kVfsNonceSize + stored.size() + kVfsTagSize, Qt::Uninitialized);
+    char *nonce = sealed.data();
+    if (RAND_bytes(reinterpret_cast<unsigned char*>(nonce), kVfsNonceSize) != 1) return false;
+    if (!vfsGcm(true, key, nonce, vfsChunkAad(c), stored.constData(), stored.size(), nonce + kVfsNonceSize,
+                nonce + kVfsNonceSize + stored.size())) return false;
+    stored = sealed;
+    c.storedSize = quint32(sealed.size());
+    return true;
+}
+
+// the compressed (or stored) bytes back out of a sealed chunk; false if anything was altered
+static bool openVfsChunk(const QByteArray &key, const VfsChunk &c, const char *sealed, QByteArray &out) {
+    const int n = int(c.storedSize) - kVfsNonceSize - kVfsTagSize;
+    if (n < 0) return false;
+    out.resize(n);
+    char tag[kVfsTagSize];
+    memcpy(tag, sealed + kVfsNonceSize + n, kVfsTagSize);
+    return vfsGcm(false, key, sealed, vfsChunkAad(c), sealed + kVfsNonceSize, n, out.data(), tag);
+}
+
+// a dictionary trained on an even sample of the small files among paths. Small files share
+// keys, boilerplate and structure that a single file is too short for zstd to learn; with the
+// dictionary each still compresses and decodes on its own. Empty when there are too few to train on.
+// The files read as samples are handed back in sampled, so adding them doesn't read them again.
+static QByteArray trainVfsDictionary(const QStringList &paths, QHash<QString, QByteArray> *sampled = nullptr) {
+    QStringList small;
+    qint64 smallBytes = 0;
+    for (const QString &path : paths) {
+        const QFileInfo fi(path);
+        if (!fi.isFile() || fi.size() == 0 || fi.size() > kVfsDictMaxEntry) continue;
+        small << path;
+        smallBytes += fi.size();
+    }
+    if (small.size() < kVfsDictMinSamples) return QByteArray();
+    const int step = int(smallBytes / kVfsDictSampleBytes) + 1;
+    QByteArray samples;
+    std::vector<size_t> sizes;
+    for (int i = 0; i < small.size(); i += step) {
+        QFile f(small.at(i));
+        if (!f.open(QIODevice::ReadOnly)) continue;
+        const QByteArray data = f.readAll();
+        if (data.isEmpty()) continue;
+        samples += data;
+        sizes.push_back(size_t(data.size()));
+        if (sampled) sampled->insert(small.at(i), data);
+    }
+    if (int(sizes.size()) < kVfsDictMinSamples) return QByteArray();
+    QByteArray dict(kVfsDictSize, Qt::Uninitialized);
+    const size_t n = ZDICT_trainFromBuffer(dict.data(), size_t(dict.size()), samples.constData(), sizes.data(), unsigned(sizes.size()));
+    if (ZDICT_isError(n)) return QByteArray();
+    dict.resize(int(n));
+    return dict;
+}
+
+// FastCDC-style cut points: a gear hash over the bytes, with a cut wherever its top bits are
+// all zero. The mask is stricter before the average chunk size and looser after it, which
+// keeps sizes close to the average. An edit only moves the cuts next to it, so the rest of a
+// changed file splits into the same chunks as the version before it.
+static const quint64 *vfsGearTable() {
+    static quint64 table[256];
+    static const bool ready = [] {
+        quint64 x = 0;
+        for (quint64 &g : table) {
+            quint64 z = (x += 0x9E3779B97F4A7C15ULL);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+            g = z ^ (z >> 31);
+        }
+        return true;
+    }();
+    Q_UNUSED(ready);
+    return table;
+}
+
+// length of the chunk starting at data: between maxSize / 16 and maxSize, averaging maxSize / 4.
+// Only call with at least maxSize bytes unless this is the end of the input.
+static qint64 vfsNextCut(const uchar *data, qint64 len, quint32 maxSize) {
+    const qint64 minSize = maxSize / 16;
+    const qint64 avgSize = maxSize / 4;
+    if (len <= minSize) return len;
+    int bits = 0;
+    while ((qint64(1) << (bits + 1)) <= avgSize) ++bits;
+    bits = qMax(bits, 3);   // the loose mask drops two bits, and a shift by 64 is undefined
+    const quint64 strict = ~quint64(0) << (64 - (bits + 2));
+    const quint64 loose = ~quint64(0) << (64 - (bits - 2));
+    const quint64 *gear = vfsGearTable();
+    const qint64 end = qMin<qint64>(len, maxSize);
+    const qint64 normal = qMin(end, avgSize);
+    quint64 h = 0;
+    qint64 i = minSize;
+    for (; i < normal; ++i) {
+        h = (h << 1) + gear[data[i]];
+        if (!(h & strict)) return i + 1;
+    }
+    for (; i < end; ++i) {
+        h = (h << 1) + gear[data[i]];
+        if (!(h & loose)) return i + 1;
+    }
+    return end;
+}
+
+// turns an entry's payload into chunks. Cutting is sequential, since the gear hash runs at memory
+// speed; the per-chunk crc, digest and compression run on a worker pool a batch at a time. With
+// dedup on, a chunk whose digest is already known (stored earlier, or earlier in the same
+// batch) is referenced instead of being compressed and written again.
+class VfsChunkEncoder {
+public:
+    // writes the stored bytes of a new chunk and sets its offset; called in payload order
+    typedef std::function<bool(const QByteArray &, VfsChunk &)> Store;
+
+    VfsChunkEncoder(quint32 chunkSize, bool dedup)
+        : m_chunkSize(chunkSize), m_dedup(dedup), m_threads(qMax(1, QThread::idealThreadCount())) {
+        m_pool.setMaxThreadCount(m_threads);
+        for (int t = 0; t < m_threads; ++t) m_cctx << ZSTD_createCCtx();
+    }
+    ~VfsChunkEncoder() {
+        for (ZSTD_CCtx *cctx : m_cctx) {
+            if (cctx) ZSTD_freeCCtx(cctx);
+        }
+        if (m_dict) ZSTD_freeCDict(m_dict);
+    }
+
+    bool isValid() const { return !m_cctx.contains(nullptr); }
+
+    // payloads of up to kVfsDictMaxEntry bytes are compressed against dict from here on
+    bool setDictionary(const QByteArray &dict) {
+        if (m_dict) ZSTD_freeCDict(m_dict);
+        m_dict = dict.isEmpty() ? nullptr : ZSTD_createCDict(dict.constData(), size_t(dict.size()), kVfsZstdLevel);
+        return dict.isEmpty() || m_dict;
+    }
+
+    // one chunk on the calling thread, for re-encoding a copied chunk
+    bool encodeOne(const char *data, quint32 n, VfsChunk &c, QByteArray &out) {
+        c.crc = quint32(crc32(0, reinterpret_cast<const Bytef*>(data), n));
+        encodeVfsChunk(m_cctx.first(), data, n, c, out, nullptr, vfsChooseLevel(data, int(n)));
+        return m_key.isEmpty() || sealVfsChunk(m_key, c, out);
+    }
+
+    // chunks[i] packed again at level on the pool, load(i, raw) supplying its bytes. out[i] stays
+    // empty, and chunks[i] as it was, where that isn't smaller than what is stored now
+    bool repack(QVector<VfsChunk> &chunks, int level, const std::function<bool(int, QByteArray &)> &load,
+                QVector<QByteArray> &out) {
+        out = QVector<QByteArray>(chunks.size());
+        QAtomicInt failed(0);
+        parallelFor(chunks.size(), [&](int i, int t) {
+            QByteArray raw;
+            if (!load(i, raw)) { failed.store(1); return; }
+            VfsChunk c = chunks.at(i);
+            QByteArray bytes;
+            encodeVfsChunk(m_cctx.at(t), raw.constData(), quint32(raw.size()), c, bytes, nullptr, level);
+            if (!m_key.isEmpty() && !sealVfsChunk(m_key, c, bytes)) { failed.store(1); return; }
+            if (c.storedSize >= chunks.at(i).storedSize) return;
+            chunks[i] = c;
+            out[i] = bytes;
+        });
+        return !failed.load();
+    }
+
+    // chunks are sealed from here on, and digests keyed
+    void setKey(const VfsKey &key) {
+        m_key = key.key;
+        m_digestKey = key.digestKey();
+    }
+
+    QByteArray digest(const char *data, int len) const {
+        QCryptographicHash h(QCryptographicHash::Blake2b_256);
+        h.addData(m_digestKey);
+        h.addData(data, len);
+        return h.result();
+    }
+
+    // a chunk already in the archive that new payloads may point at
+    void remember(const VfsChunk &c) {
+        if (m_dedup && c.digest.size() == kVfsDigestSize) m_known.insert(c.digest, c);
+    }
+
+    bool lookup(const QByteArray &digest, VfsChunk &c) const {
+        auto it = m_known.constFind(digest);
+        if (it == m_known.constEnd()) return false;
+        c = it.value();
+        return true;
+    }
+
+    bool encode(QIODevice &in, const Store &store, QVector<VfsChunk> &chunks, qint64 &size, quint32 &crc,
+                ArchiveOperation *op) {
+        const int batch = int(m_chunkSize) * 64;
+        const ZSTD_CDict *dict = m_dict && in.size() <= kVfsDictMaxEntry ? m_dict : nullptr;
+        int level = -1;   // picked once the first block is in
+        QByteArray buf;
+        int used = 0;   // bytes of buf already cut
+        bool eof = false;
+        uLong total = crc32(0, nullptr, 0);
+        size = 0;
+        while (!eof || used < buf.size()) {
+            if (op && op->isCancelled()) return false;
+            if (!eof) {
+                buf.remove(0, used);
+                used = 0;
+                const int have = buf.size();
+                buf.resize(batch);
+                const qint64 n = in.read(buf.data() + have, batch - have);
+                if (n < 0) return false;
+                buf.resize(have + int(n));
+                eof = buf.size() < batch;
+            }
+            if (level < 0) level = vfsChooseLevel(buf.constData(), buf.size());
+            // whole chunks only, the tail waits for more input unless there is none
+            QVector<Piece> pieces;
+            while (used < buf.size()) {
+                const int left = buf.size() - used;
+                if (!eof && left < int(m_chunkSize)) break;
+                const int n = m_dedup ? int(vfsNextCut(reinterpret_cast<const uchar*>(buf.constData()) + used, left, m_chunkSize))
+                                      : qMin(left, int(m_chunkSize));
+                Piece p;
+                p.at = used;
+                p.len = n;
+                pieces << p;
+                used += n;
+            }
+            if (!encodeBatch(buf, pieces, level ? dict : nullptr, level, store, chunks, total, op)) return false;
+            for (const Piece &p : pieces) size += p.len;
+        }
+        crc = quint32(total);
+        return true;
+    }
+
+private:
+    struct Piece {
+        int at = 0;
+        int len = 0;
+        VfsChunk chunk;
+        QByteArray stored;
+        int sameAs = -1;     // earlier piece of this batch with the same bytes
+        bool isNew = true;   // still has to be compressed and written
+    };
+
+    // fn(i, worker) for i in [0, n) spread over the pool
+    template<typename Fn>
+    void parallelFor(int n, Fn fn) {
+        const int threads = qMin(m_threads, n);
+        if (threads <= 1) {
+            for (int i = 0; i < n; ++i) fn(i, 0);
+            return;
+        }
+        QAtomicInt next(0);
+        for (int t = 0; t < threads; ++t) {
+            m_pool.start(new FunctionRunnable([&next, &fn, n, t]() {
+                for (int i = next.fetchAndAddRelaxed(1); i < n; i = next.fetchAndAddRelaxed(1)) fn(i, t);
+            }));
+        }
+        m_pool.waitForDone();
+    }
+
+    bool encodeBatch(const QByteArray &buf, QVector<Piece> &pieces, const ZSTD_CDict *dict, int level, const Store &store,
+                     QVector<VfsChunk> &chunks, uLong &total, ArchiveOperation *op) {
+        const char *data = buf.constData();
+        QAtomicInt failed(0);
+        auto pack = [&](Piece &p, int t) {
+            encodeVfsChunk(m_cctx.at(t), data + p.at, quint32(p.len), p.chunk, p.stored, dict, level);
+            if (!m_key.isEmpty() && !sealVfsChunk(m_key, p.chunk, p.stored)) failed.store(1);
+        };
+        // one sweep per chunk while it is still in cache: crc, then straight on to compression.
+        // With dedup the sweep computes the digest instead, and compression has to wait until
+        // the duplicates are known.
+        parallelFor(pieces.size(), [&](int i, int t) {
+            Piece &p = pieces[i];
+            p.chunk.rawSize = quint32(p.len);
+            p.chunk.crc = quint32(crc32(0, reinterpret_cast<const Bytef*>(data + p.at), uInt(p.len)));
+            if (m_dedup) p.chunk.digest = digest(data + p.at, p.len);
+            else pack(p, t);
+        });
+        if (m_dedup) {
+            QHash<QByteArray, int> seen;
+            for (int i = 0; i < pieces.size(); ++i) {
+                Piece &p = pieces[i];
+                if (lookup(p.chunk.digest, p.chunk)) {
+                    p.isNew = false;
+                } else if (seen.contains(p.chunk.digest)) {
+                    p.sameAs = seen.value(p.chunk.digest);
+                    p.isNew = false;
+                } else {
+                    seen.insert(p.chunk.digest, i);
+                }
+            }
+            parallelFor(pieces.size(), [&](int i, int t) {
+                if (pieces.at(i).isNew) pack(pieces[i], t);
+            });
+        }
+        if (failed.load()) return false;
+        for (Piece &p : pieces) {
+            if (p.isNew) {
+                if (!store(p.stored, p.chunk)) return false;
+                p.stored.clear();
+                remember(p.chunk);
+            } else if (p.sameAs >= 0) {
+                p.chunk = pieces.at(p.sameAs).chunk;
+            }
+            chunks << p.chunk;
+            total = crc32_combine(total, p.chunk.crc, p.len);
+            if (op) op->advance(p.len);
+        }
+        return true;
+    }
+
+    const quint32 m_chunkSize;
+    const bool m_dedup;
+    const int m_threads;
+    QThreadPool m_pool;
+    QVector<ZSTD_CCtx*> m_cctx;   // one per worker
+    ZSTD_CDict *m_dict = nullptr;  // shared read-only by every worker
+    QByteArray m_key;
+    QByteArray m_digestKey;
+    QHash<QByteArray, VfsChunk> m_known;
+};
+
+// FNV-1a with a splitmix finalizer: unlike qHash it is the same on every platform and Qt build
+static quint64 vfsNameHash(const char *p, int len, quint32 seed) {
+    quint64 h = 0xcbf29ce484222325ULL ^ seed;
+    for (int i = 0; i < len; ++i) {
+        h ^= uchar(p[i]);
+        h *= 0x100000001b3ULL;
+    }
+    h ^= h >> 30;
+    h *= 0xbf58476d1ce4e5b9ULL;
+    h ^= h >> 27;
+    h *= 0x94d049bb133111ebULL;
+    return h ^ (h >> 31);
+}
+
+// the low 32 bits pick the bucket, the high ones drive the slot probe sequence h1 + d * h2
+static quint32 vfsSlot(quint64 h, quint32 displacement, quint32 slotCount) {
+    const quint64 h1 = h >> 32;
+    const quint64 h2 = ((h * 0x9e3779b97f4a7c15ULL) >> 32) | 1;
+    return quint32((h1 + quint64(displacement) * h2) % slotCount);
+}
+
+// hash and displace: names are spread over buckets, then each bucket, fullest first, gets the
+// smallest displacement that lands all of its names in free slots. Fails only on a full
+// 64-bit collision or an unlucky probe sequence; the caller then retries with another seed.
+static bool buildVfsPerfectHash(const QVector<QByteArray> &names, quint32 seed,
+                                QVector<quint32> &displacements, QVector<quint32> &slotTable) {
+    static const quint32 kMaxDisplacement = 1 << 16;
+    const int n = names.size();
+    const int bucketCount = n / 4 + 1;
+    const int slotCount = n + n / 4 + 1;
+    QVector<quint64> hashes(n);
+    QVector<QVector<int>> buckets(bucketCount);
+    for (int i = 0; i < n; ++i) {
+        hashes[i] = vfsNameHash(names.at(i).constData(), names.at(i).size(), seed);
+        buckets[int(quint32(hashes.at(i)) % quint32(bucketCount))] << i;
+    }
+    QVector<int> order(bucketCount);
+    for (int b = 0; b < order.size(); ++b) order[b] = b;
+    std::stable_sort(order.begin(), order.end(), [&buckets](int a, int b) { return buckets.at(a).size() > buckets.at(b).size(); });
+
+    displacements.fill(0, bucketCount);
+    slotTable.fill(kVfsNoEntry, slotCount);
+    QVector<quint32> taken;
+    for (int b : order) {
+        const QVector<int> &members = buckets.at(b);
+        if (members.isEmpty()) break;
+        auto fits = [&](quint32 d) {
+            taken.clear();
+            for (int i : members) {
+                const quint32 s = vfsSlot(hashes.at(i), d, quint32(slotCount));
+                if (slotTable.at(int(s)) != kVfsNoEntry || taken.contains(s)) return false;
+                taken << s;
+            }
+            return true;
+        };
+        quint32 d = 0;
+        while (d < kMaxDisplacement && !fits(d)) ++d;
+        if (d == kMaxDisplacement) return false;
+        displacements[b] = d;
+        for (int k = 0; k < members.size(); ++k) slotTable[int(taken.at(k))] = quint32(members.at(k));
+    }
+    return true;
+}
+
+// read side of a .vfsarc; immutable once open, so one instance is shared by every thread and
+// stays a consistent snapshot while later edits are appended behind it
+class VfsArchive {
+public:
+    struct Entry {
+        QString name;          // directories end in '/'
+        bool isDir = false;
+        qint64 size = 0;
+        quint32 crc = 0;
+        qint64 mtime = 0;      // ms since epoch
+        quint32 firstRef = 0;
+        quint32 refCount = 0;
+        bool inLog = false;
+        QVector<VfsChunk> chunks;   // entries from the log carry their chunk records, index entries use refs
+    };
+
+    ~VfsArchive() {
+        if (m_ddict) ZSTD_freeDDict(m_ddict);
+        if (m_base) m_file.unmap(m_base);
+    }
+
+    static bool isVfsArchive(const QString &path) {
+        QFile f(path);
+        char magic[sizeof(kVfsMagic)];
+        return f.open(QIODevice::ReadOnly) && f.read(magic, sizeof(magic)) == qint64(sizeof(magic))
+            && memcmp(magic, kVfsMagic, sizeof(magic)) == 0;
+    }
+
+    bool open(const QString &path) {
+        m_file.setFileName(path);
+        if (!m_file.open(QIODevice::ReadOnly)) return false;
+        m_size = m_file.size();
+        if (m_size < kVfsHeaderSize + kVfsTrailerSize) return false;
+        // the whole file on 64-bit; without a mapping the index is read into memory and chunks with pread-style reads
+        if (sizeof(void*) >= 8) m_base = m_file.map(0, m_size);
+
+        QByteArray scratch;
+        const char *h = span(0, kVfsHeaderSize, scratch);
+        if (!h || memcmp(h, kVfsMagic, sizeof(kVfsMagic)) != 0 || qFromLittleEndian<quint32>(h + 8) != kVfsVersion) return false;
+        m_chunkSize = qFromLittleEndian<quint32>(h + 16);
+        m_dedup = qFromLittleEndian<quint32>(h + 20) & kVfsFlagDedup;
+        m_encrypted = qFromLittleEndian<quint32>(h + 20) & kVfsFlagEncrypted;
+        if (m_encrypted) {
+            m_salt = QByteArray(h + 24, kVfsSaltSize);
+            m_iterations = qFromLittleEndian<quint32>(h + 40);
+            m_checkValue = QByteArray(h + 44, kVfsTagSize);
+        }
+        // chunk buffers are sized from it and content-defined cutting derives its masks from it
+        if (m_chunkSize < kVfsMinChunkSize || m_chunkSize > kVfsMaxChunkSize) return false;
+
+        // normally the last 64 bytes; after a torn append, the newest trailer that made it to disk
+        bool found = readTrailer(m_size - kVfsTrailerSize);
+        for (qint64 at = (m_size - kVfsTrailerSize) & ~qint64(7); !found && at >= kVfsHeaderSize; at -= 8) found = readTrailer(at);
+        if (!found) return false;
+
+        if (m_base) {
+            m_index = reinterpret_cast<const char*>(m_base) + m_trailer.indexOffset;
+        } else {
+            if (!span(m_trailer.indexOffset, m_trailer.indexSize, m_indexCopy)) return false;
+            m_index = m_indexCopy.constData();
+        }
+        if (quint32(crc32(0, reinterpret_cast<const Bytef*>(m_index), uInt(m_trailer.indexSize))) != m_trailer.indexCrc) return false;
+
+        m_entryCount = qFromLittleEndian<quint32>(m_index);
+        m_chunkCount = qFromLittleEndian<quint32>(m_index + 4);
+        m_refCount = qFromLittleEndian<quint32>(m_index + 8);
+        m_bucketCount = qFromLittleEndian<quint32>(m_index + 12);
+        m_slotCount = qFromLittleEndian<quint32>(m_index + 16);
+        m_seed = qFromLittleEndian<quint32>(m_index + 20);
+        const qint64 namesSize = qint64(qFromLittleEndian<quint64>(m_index + 24));
+        const qint64 manifestSize = qint64(qFromLittleEndian<quint64>(m_index + 32));
+        const qint64 dictSize = qFromLittleEndian<quint32>(m_index + 40);
+        if (m_bucketCount == 0 || m_slotCount == 0) return false;
+
+        // section offsets follow from the counts, each section starting 8-aligned
+        qint64 at = kVfsIndexHeaderSize;
+        m_entries = at;   at += qint64(m_entryCount) * kVfsEntryRecordSize;
+        m_chunks = at;    at += qint64(m_chunkCount) * kVfsChunkRecordSize;
+        m_digests = at;   at += m_dedup ? qint64(m_chunkCount) * kVfsDigestSize : 0;
+        m_refs = at;      at = vfsAlign8(at + qint64(m_refCount) * 4);
+        m_buckets = at;   at = vfsAlign8(at + qint64(m_bucketCount) * 4);
+        m_slots = at;     at = vfsAlign8(at + qint64(m_slotCount) * 4);
+        m_names = at;     at = vfsAlign8(at + namesSize);
+        m_manifestOffset = at;  at = vfsAlign8(at + manifestSize);
+        const qint64 dictOffset = at;  at += dictSize;
+        m_namesSize = namesSize;
+        if (namesSize < 0 || manifestSize < 0 || at > m_trailer.indexSize) return false;
+        m_manifest = QByteArray(m_index + m_manifestOffset, int(manifestSize));
+        m_dict = QByteArray(m_index + dictOffset, int(dictSize));
+        if (!replayLog()) return false;
+        // digested once here; every decode of a small entry after that starts from it ready-made
+        if (!m_dict.isEmpty()) m_ddict = ZSTD_createDDict(m_dict.constData(), size_t(m_dict.size()));
+        return m_dict.isEmpty() || m_ddict;
+    }
+
+    QString path() const { return m_file.fileName(); }
+    // the largest chunk; with dedup chunks vary in size below it
+    quint32 chunkSize() const { return m_chunkSize; }
+    bool isDeduplicated() const { return m_dedup; }
+    bool isEncrypted() const { return m_encrypted; }
+
+    // slow on purpose; the result is what setKey() wants
+    VfsKey deriveKey(const QString &password) const {
+        return m_encrypted ? VfsKey::derive(password, m_salt, m_iterations) : VfsKey();
+    }
+
+    // chunks of an encrypted archive only decode once the right key is set; call before sharing the archive
+    bool setKey(const VfsKey &key) {
+        if (!m_encrypted || key.isNull() || key.salt != m_salt) return false;
+        const QByteArray check = key.checkValue();
+        if (check.size() != kVfsTagSize || CRYPTO_memcmp(check.constData(), m_checkValue.constData(), kVfsTagSize) != 0) return false;
+        m_key = key;
+        return true;
+    }
+
+    const VfsKey &key() const { return m_key; }
+    QByteArray manifest() const { return m_manifest; }
+    // shared zstd dictionary of the small entries, empty when there is none
+    QByteArray dictionary() const { return m_dict; }
+    const VfsTrailer &trailer() const { return m_trailer; }
+    // end of the newest good trailer; an append starts here
+    qint64 end() const { return m_end; }
+
+    // the log first, then the perfect-hash index: one bucket read, one slot read, one name compare
+    bool find(const QString &name, Entry &out) const {
+        const QByteArray key = name.toUtf8();
+        auto it = m_log.constFind(key);
+        if (it != m_log.constEnd()) {
+            out = it.value();
+            return true;
+        }
+        if (m_tombstones.contains(key)) return false;
+        const int i = indexFind(key);
+        if (i < 0) return false;
+        out = indexEntry(i);
+        return true;
+    }
+
+    QStringList names(const QString &prefix = QString()) const {
+        QStringList out;
+        forEachLive(prefix.toUtf8(), [&out](const QByteArray &name, int, const Entry *) { out << QString::fromUtf8(name); });
+        return out;
+    }
+
+    QVector<Entry> entries(const QString &prefix = QString()) const {
+        QVector<Entry> out;
+        forEachLive(prefix.toUtf8(), [this, &out](const QByteArray &, int i, const Entry *logged) {
+            out << (logged ? *logged : indexEntry(i));
+        });
+        return out;
+    }
+
+    // where each chunk of e starts within the entry
+    QVector<qint64> chunkStarts(const Entry &e) const {
+        QVector<qint64> starts;
+        starts.reserve(int(e.refCount));
+        qint64 at = 0;
+        VfsChunk c;
+        for (int k = 0; k < int(e.refCount); ++k) {
+            starts << at;
+            if (chunkFor(e, k, c)) at += c.rawSize;
+        }
+        return starts;
+    }
+
+    // every chunk a new payload may point at instead of storing the same bytes again
+    QVector<VfsChunk> knownChunks() const {
+        QVector<VfsChunk> out;
+        if (!m_dedup) return out;
+        for (quint32 id = 0; id < m_chunkCount; ++id) {
+            VfsChunk c = VfsChunk::decode(m_index + m_chunks + qint64(id) * kVfsChunkRecordSize);
+            c.digest = QByteArray(m_index + m_digests + qint64(id) * kVfsDigestSize, kVfsDigestSize);
+            out << c;
+        }
+        for (const Entry &e : m_log) out += e.chunks;
+        return out;
+    }
+
+    bool chunkFor(const Entry &e, int k, VfsChunk &out) const {
+        if (k < 0 || quint32(k) >= e.refCount) return false;
+        if (e.inLog) {
+            if (k >= e.chunks.size()) return false;
+            out = e.chunks.at(k);
+        } else {
+            if (quint64(e.firstRef) + quint32(k) >= m_refCount) return false;
+            const quint32 id = qFromLittleEndian<quint32>(m_index + m_refs + qint64(e.firstRef + quint32(k)) * 4);
+            if (id >= m_chunkCount) return false;
+            out = VfsChunk::decode(m_index + m_chunks + qint64(id) * kVfsChunkRecordSize);
+        }
+        return out.offset >= kVfsHeaderSize && out.offset + out.storedSize <= m_end;
+    }
+
+    // the chunk exactly as stored, for copying into another archive without recompressing
+    bool storedChunk(const Entry &e, int k, VfsChunk &c, QByteArray &bytes) const {
+        QByteArray scratch;
+        const char *src = chunkFor(e, k, c) ? span(c.offset, c.storedSize, scratch) : nullptr;
+        if (!src) return false;
+        bytes = scratch.isEmpty() ? QByteArray(src, int(c.storedSize)) : scratch;
+        if (m_dedup && !e.inLog) {
+            const quint32 id = qFromLittleEndian<quint32>(m_index + m_refs + qint64(e.firstRef + quint32(k)) * 4);
+            c.digest = QByteArray(m_index + m_digests + qint64(id) * kVfsDigestSize, kVfsDigestSize);
+        }
+        return true;
+    }
+
+    // chunk k of e into dst, which has room for its raw size; the chunk crc is checked
+    bool decodeChunk(const Entry &e, int k, char *dst) const {
+        VfsChunk c;
+        QByteArray scratch;
+        const char *src = chunkFor(e, k, c) ? span(c.offset, c.storedSize, scratch) : nullptr;
+        if (!src) return false;
+        size_t len = c.storedSize;
+        QByteArray plain;
+        if (m_encrypted) {
+            if (m_key.isNull() || !openVfsChunk(m_key.key, c, src, plain)) return false;
+            src = plain.constData();
+            len = size_t(plain.size());
+        }
+        if (c.method == VfsChunk::Stored) {
+            if (len != c.rawSize) return false;
+            memcpy(dst, src, c.rawSize);
+        } else if (c.method == VfsChunk::Zstd) {
+            if (ZSTD_decompress(dst, c.rawSize, src, len) != c.rawSize) return false;
+        } else if (c.method == VfsChunk::ZstdDict && m_ddict) {
+            ZSTD_DCtx *dctx = ZSTD_createDCtx();
+            const size_t n = dctx ? ZSTD_decompress_usingDDict(dctx, dst, c.rawSize, src, len, m_ddict) : 0;
+            if (dctx) ZSTD_freeDCtx(dctx);
+            if (n != c.rawSize) return false;
+        } else {
+            return false;
+        }
+        return quint32(crc32(0, reinterpret_cast<const Bytef*>(dst), c.rawSize)) == c.crc;
+    }
+
+    // any byte range of an entry: only the chunks it touches are decoded
+    qint64 read(const Entry &e, qint64 offset, char *dst, qint64 len) const {
+        const QVector<qint64> starts = chunkStarts(e);
+        qint64 done = 0;
+        QByteArray buf;
+        while (done < len && offset + done < e.size) {
+            const qint64 pos = offset + done;
+            const int k = int(std::upper_bound(starts.begin(), starts.end(), pos) - starts.begin()) - 1;
+            const qint64 inner = k >= 0 ? pos - starts.at(k) : 0;
+            VfsChunk c;
+            if (!chunkFor(e, k, c) || inner >= c.rawSize) return -1;
+            const qint64 n = qMin<qint64>(c.rawSize - inner, len - done);
+            if (inner == 0 && n == c.rawSize) {
+                if (!decodeChunk(e, k, dst + done)) return -1;
+            } else {
+                buf.resize(int(c.rawSize));
+                if (!decodeChunk(e, k, buf.data())) return -1;
+                memcpy(dst + done, buf.constData() + inner, size_t(n));
+            }
+            done += n;
+        }
+        return done;
+    }
+
+private:
+    // len bytes at offset: straight from the mapping, or read into scratch
+    const char *span(qint64 offset, qint64 len, QByteArray &scratch) const {
+        if (offset < 0 || len < 0 || offset + len > m_size) return nullptr;
+        if (m_base) return reinterpret_cast<const char*>(m_base) + offset;
+        QMutexLocker lock(&m_ioMutex);
+        if (!m_file.seek(offset)) return nullptr;
+        scratch = m_file.read(len);
+        return scratch.size() == len ? scratch.constData() : nullptr;
+    }
+
+    bool readTrailer(qint64 at) {
+        QByteArray scratch;
+        const char *t = span(at, kVfsTrailerSize, scratch);
+        if (!t || !m_trailer.decode(t, at)) return false;
+        m_end = at + kVfsTrailerSize;
+        return true;
+    }
+
+    // walks the chain back from the trailer, then applies the records oldest first
+    bool replayLog() {
+        QVector<QByteArray> records;
+        for (qint64 at = m_trailer.logOffset, size = m_trailer.logSize; at != 0; ) {
+            QByteArray rec;
+            const char *p = size >= kVfsLogHeaderSize + 4 ? span(at, size, rec) : nullptr;
+            if (!p) return false;
+            if (rec.isEmpty()) rec = QByteArray(p, int(size));
+            if (memcmp(p, kVfsLogMagic, sizeof(kVfsLogMagic)) != 0
+                || qFromLittleEndian<quint32>(p + size - 4) != quint32(crc32(0, reinterpret_cast<const Bytef*>(p), uInt(size - 4)))) return false;
+            records.prepend(rec);
+            const qint64 prev = qint64(qFromLittleEndian<quint64>(p + 8));
+            size = qint64(qFromLittleEndian<quint64>(p + 16));
+            if (prev >= at) return false;   // the chain only ever points backwards
+            at = prev;
+        }
+        for (const QByteArray &rec : records) {
+            if (!applyLogRecord(rec)) return false;
+        }
+        return true;
+    }
+
+    bool applyLogRecord(const QByteArray &rec) {
+        const char *p = rec.constData();
+        const quint32 added = qFromLittleEndian<quint32>(p + 24);
+        const quint32 removed = qFromLittleEndian<quint32>(p + 28);
+        const qint64 manifestSize = qint64(qFromLittleEndian<quint64>(p + 32));
+        const qint64 dictSize = qFromLittleEndian<quint32>(p + 40);
+        const qint64 end = rec.size() - 4;
+        qint64 at = kVfsLogHeaderSize;
+        for (quint32 i = 0; i < added; ++i) {
+            if (at + kVfsLogEntrySize > end) return false;
+            const quint32 nameLen = qFromLittleEndian<quint32>(p + at);
+            Entry e;
+            e.isDir = qFromLittleEndian<quint32>(p + at + 4) & kVfsEntryDir;
+            e.size = qint64(qFromLittleEndian<quint64>(p + at + 8));
+            e.crc = qFromLittleEndian<quint32>(p + at + 16);
+            e.refCount = qFromLittleEndian<quint32>(p + at + 20);
+            e.mtime = qint64(qFromLittleEndian<quint64>(p + at + 24));
+            e.inLog = true;
+            at += kVfsLogEntrySize;
+            const int recordSize = kVfsChunkRecordSize + (m_dedup ? kVfsDigestSize : 0);
+            if (at + nameLen + qint64(e.refCount) * recordSize > end) return false;
+            const QByteArray name(p + at, int(nameLen));
+            at += nameLen;
+            e.name = QString::fromUtf8(name);
+            for (quint32 k = 0; k < e.refCount; ++k, at += recordSize) {
+                VfsChunk c = VfsChunk::decode(p + at);
+                if (m_dedup) c.digest = QByteArray(p + at + kVfsChunkRecordSize, kVfsDigestSize);
+                e.chunks << c;
+            }
+            m_log.insert(name, e);
+        }
+        for (quint32 i = 0; i < removed; ++i) {
+            if (at + 4 > end) return false;
+            const quint32 nameLen = qFromLittleEndian<quint32>(p + at);
+            if (at + 4 + nameLen > end) return false;
+            const QByteArray name(p + at + 4, int(nameLen));
+            at += 4 + nameLen;
+            m_log.remove(name);
+            m_tombstones.insert(name);
+        }
+        if (manifestSize < 0 || at + manifestSize + dictSize > end) return false;
+        if (manifestSize > 0) m_manifest = QByteArray(p + at, int(manifestSize));
+        at += manifestSize;
+        if (dictSize > 0) {
+            // chunks already packed against the first dictionary could not be read with another
+            if (!m_dict.isEmpty()) return false;
+            m_dict = QByteArray(p + at, int(dictSize));
+        }
+        return true;
+    }
+
+    // live entries under prefix in name order: the index run merged with the log overlay,
+    // skipping index entries the log replaced or removed. fn(name, indexPos, logEntry or null)
+    template<typename Fn>
+    void forEachLive(const QByteArray &prefix, Fn fn) const {
+        auto logIt = m_log.lowerBound(prefix);
+        auto flushLog = [&](const QByteArray *upTo) {
+            for (; logIt != m_log.constEnd() && logIt.key().startsWith(prefix) && (!upTo || logIt.key() < *upTo); ++logIt) {
+                fn(logIt.key(), -1, &logIt.value());
+            }
+        };
+        for (int i = indexLowerBound(prefix); i < int(m_entryCount); ++i) {
+            const QByteArray name = indexName(i);
+            if (!name.startsWith(prefix)) break;
+            flushLog(&name);
+            if (m_tombstones.contains(name) || m_log.contains(name)) continue;
+            fn(name, i, nullptr);
+        }
+        flushLog(nullptr);
+    }
+
+    Entry indexEntry(int i) const {
+        const char *r = m_index + m_entries + qint64(i) * kVfsEntryRecordSize;
+        Entry e;
+        e.name = QString::fromUtf8(indexName(i));
+        e.isDir = qFromLittleEndian<quint32>(r + 12) & kVfsEntryDir;
+        e.size = qint64(qFromLittleEndian<quint64>(r + 16));
+        e.firstRef = qFromLittleEndian<quint32>(r + 24);
+        e.refCount = qFromLittleEndian<quint32>(r + 28);
+        e.crc = qFromLittleEndian<quint32>(r + 32);
+        e.mtime = qint64(qFromLittleEndian<quint64>(r + 40));
+        return e;
+    }
+
+    // points into the index, valid as long as the archive is
+    QByteArray indexName(int i) const {
+        const char *r = m_index + m_entries + qint64(i) * kVfsEntryRecordSize;
+        const qint64 offset = qint64(qFromLittleEndian<quint64>(r));
+        const quint32 len = qFromLittleEndian<quint32>(r + 8);
+        if (offset < 0 || offset + len > m_namesSize) return QByteArray();
+        return QByteArray::fromRawData(m_index + m_names + offset, int(len));
+    }
+
+    int indexFind(const QByteArray &key) const {
+        const quint64 h = vfsNameHash(key.constData(), key.size(), m_seed);
+        const quint32 d = qFromLittleEndian<quint32>(m_index + m_buckets + qint64(quint32(h) % m_bucketCount) * 4);
+        const quint32 e = qFromLittleEndian<quint32>(m_index + m_slots + qint64(vfsSlot(h, d, m_slotCount)) * 4);
+        return e < m_entryCount && indexName(int(e)) == key ? int(e) : -1;
+    }
+
+    // index entries are sorted by their UTF-8 names, so everything under a prefix is one run from here
+    int indexLowerBound(const QByteArray &key) const {
+        int lo = 0, hi = int(m_entryCount);
+        while (lo < hi) {
+            const int mid = (lo + hi) / 2;
+            if (indexName(mid) < key) lo = mid + 1;
+            else hi = mid;
+        }
+        return lo;
+    }
+
+    mutable QFile m_file;
+    mutable QMutex m_ioMutex;   // only for reads without a mapping
+    uchar *m_base = nullptr;
+    qint64 m_size = 0;
+    qint64 m_end = 0;
+    VfsTrailer m_trailer;
+    QByteArray m_indexCopy;
+    const char *m_index = nullptr;
+    quint32 m_chunkSize = 0;
+    bool m_dedup = false;
+    bool m_encrypted = false;
+    QByteArray m_salt;
+    quint32 m_iterations = 0;
+    QByteArray m_checkValue;
+    VfsKey m_key;
+    quint32 m_entryCount = 0;
+    quint32 m_chunkCount = 0;
+    quint32 m_refCount = 0;
+    quint32 m_bucketCount = 0;
+    quint32 m_slotCount = 0;
+    quint32 m_seed = 0;
+    qint64 m_entries = 0;
+    qint64 m_chunks = 0;
+    qint64 m_digests = 0;
+    qint64 m_refs = 0;
+    qint64 m_buckets = 0;
+    qint64 m_slots = 0;
+    qint64 m_names = 0;
+    qint64 m_namesSize = 0;
+    qint64 m_manifestOffset = 0;
+    QByteArray m_manifest;
+    QByteArray m_dict;
+    ZSTD_DDict *m_ddict = nullptr;
+    QMap<QByteArray, Entry> m_log;    // added or replaced since the index was written
+    QSet<QByteArray> m_tombstones;    // removed since the index was written
+};
+
+class VfsArchiveWriter {
+public:
+    // dedup: content-defined chunks, each distinct one stored once
+    explicit VfsArchiveWriter(const QString &path, quint32 chunkSize = kVfsChunkSize, bool dedup = false)
+        : m_file(path), m_chunkSize(chunkSize), m_dedup(dedup), m_encoder(chunkSize, dedup) {}
+
+    // before open(): every chunk is sealed with key, whose salt goes into the header
+    void setKey(const VfsKey &key) {
+        m_key = key;
+        m_encoder.setKey(key);
+    }
+
+    bool open() {
+        if (!m_encoder.isValid() || !m_file.open(QIODevice::WriteOnly)) return false;
+        QByteArray header(kVfsHeaderSize, '\0');
+        memcpy(header.data(), kVfsMagic, sizeof(kVfsMagic));
+        qToLittleEndian<quint32>(kVfsVersion, header.data() + 8);
+        qToLittleEndian<quint32>(m_chunkSize, header.data() + 16);
+        qToLittleEndian<quint32>((m_dedup ? kVfsFlagDedup : 0) | (m_key.isNull() ? 0 : kVfsFlagEncrypted), header.data() + 20);
+        if (!m_key.isNull()) {
+            const QByteArray check = m_key.checkValue();
+            if (check.size() != kVfsTagSize) return false;
+            memcpy(header.data() + 24, m_key.salt.constData(), kVfsSaltSize);
+            qToLittleEndian<quint32>(m_key.iterations, header.data() + 40);
+            memcpy(header.data() + 44, check.constData(), kVfsTagSize);
+        }
+        return write(header);
+    }
+
+    void setManifest(const QByteArray &json) { m_manifest = json; }
+
+    // stored once in the index; files added afterwards that are small enough are packed against it
+    bool setDictionary(const QByteArray &dict) {
+        m_dict = dict;
+        return m_encoder.setDictionary(dict);
+    }
+
+    bool addDirectory(const QString &name, qint64 mtime) {
+        Pending p;
+        p.name = (name.endsWith('/') ? name : name + '/').toUtf8();
+        p.flags = kVfsEntryDir;
+        p.mtime = mtime;
+        m_pending << p;
+        return true;
+    }
+
+    bool addFile(const QString &name, const QString &source, ArchiveOperation *op = nullptr) {
+        QFile in(source);
+        if (!in.open(QIODevice::ReadOnly)) return false;
+        adviseSequentialRead(in.handle(), 0, in.size());
+        Pending p;
+        p.name = name.toUtf8();
+        p.mtime = QFileInfo(source).lastModified().toMSecsSinceEpoch();
+        QVector<VfsChunk> chunks;
+        auto store = [this](const QByteArray &bytes, VfsChunk &c) { return storeChunk(bytes, c); };
+        if (!m_encoder.encode(in, store, chunks, p.size, p.crc, op)) return false;
+        for (const VfsChunk &c : chunks) p.chunks << m_idAt.value(c.offset);
+        m_pending << p;
+        return true;
+    }
+
+    // the entry's chunks are copied as stored, nothing is decompressed or recompressed
+    bool copyEntry(const VfsArchive &src, const VfsArchive::Entry &e) {
+        if (src.chunkSize() != m_chunkSize) return false;
+        Pending p;
+        p.name = (e.isDir && !e.name.endsWith('/') ? e.name + '/' : e.name).toUtf8();
+        p.flags = e.isDir ? kVfsEntryDir : 0;
+        p.size = e.size;
+        p.crc = e.crc;
+        p.mtime = e.mtime;
+        // chunks sealed under another key, or packed against another dictionary, are the only
+        // ones that have to be decoded and encoded again
+        const bool sameKey = src.key() == m_key;
+        for (int k = 0; k < int(e.refCount); ++k) {
+            VfsChunk c;
+            QByteArray bytes;
+            if (!src.storedChunk(e, k, c, bytes)) return false;
+            const bool reencode = !sameKey || (c.method == VfsChunk::ZstdDict && src.dictionary() != m_dict);
+            if (!sameKey) c.digest.clear();
+            QByteArray raw;
+            if (reencode || (m_dedup && c.digest.isEmpty())) {
+                raw.resize(int(c.rawSize));
+                if (!src.decodeChunk(e, k, raw.data())) return false;
+            }
+            if (m_dedup) {
+                // a source without digests pays one decode per chunk to get them
+                if (c.digest.isEmpty()) c.digest = m_encoder.digest(raw.constData(), raw.size());
+                VfsChunk known;
+                if (m_encoder.lookup(c.digest, known)) {
+                    p.chunks << m_idAt.value(known.offset);
+                    continue;
+                }
+            }
+            if (reencode && !m_encoder.encodeOne(raw.constData(), c.rawSize, c, bytes)) return false;
+            if (!storeChunk(bytes, c)) return false;
+            m_encoder.remember(c);
+            p.chunks << m_idAt.value(c.offset);
+        }
+        m_pending << p;
+        return true;
+    }
+
+    // copies entries as copyEntry does, except that their zstd chunks are packed again at level on
+    // the encoder's pool, a batch at a time, and keep the new bytes only where they are smaller.
+    // Dictionary-packed chunks belong to small entries and stay as they are. src must share this
+    // writer's key; repacked counts the entries that shrank.
+    bool recompressEntries(const VfsArchive &src, const QVector<VfsArchive::Entry> &entries, int level, int &repacked,
+                           ArchiveOperation *op) {
+        if (src.chunkSize() != m_chunkSize || !(src.key() == m_key)) return false;
+        static const int kBatch = 64;
+        repacked = 0;
+        for (int first = 0; first < entries.size(); ) {
+            if (op && op->isCancelled()) return false;
+            // whole entries, up to kBatch chunks unless one entry alone has more
+            int last = first;
+            int count = 0;
+            do { count += int(entries.at(last).refCount); ++last; }
+            while (last < entries.size() && count + int(entries.at(last).refCount) <= kBatch);
+
+            QVector<VfsChunk> chunks;
+            QVector<QByteArray> stored;
+            QVector<QPair<int, int>> at;   // (entry, chunk) of every chunk in the batch
+            for (int i = first; i < last; ++i) {
+                const VfsArchive::Entry &e = entries.at(i);
+                for (int k = 0; k < int(e.refCount); ++k) {
+                    VfsChunk c;
+                    QByteArray bytes;
+                    if (!src.storedChunk(e, k, c, bytes)) return false;
+                    if (m_dedup && c.digest.isEmpty()) {
+                        // log entries carry no digests
+                        QByteArray raw(int(c.rawSize), Qt::Uninitialized);
+                        if (!src.decodeChunk(e, k, raw.data())) return false;
+                        c.digest = m_encoder.digest(raw.constData(), raw.size());
+                    }
+                    chunks << c;
+                    stored << bytes;
+                    at << qMakePair(i, k);
+                }
+            }
+            // chunks already written (under dedup) or not plain zstd are left alone
+            QVector<int> todo;
+            QVector<VfsChunk> work;
+            for (int j = 0; j < chunks.size(); ++j) {
+                VfsChunk known;
+                if (chunks.at(j).method != VfsChunk::Zstd || (m_dedup && m_encoder.lookup(chunks.at(j).digest, known))) continue;
+                todo << j;
+                work << chunks.at(j);
+            }
+            QVector<QByteArray> packed;
+            auto load = [&](int w, QByteArray &raw) {
+                const QPair<int, int> ek = at.at(todo.at(w));
+                raw.resize(int(work.at(w).rawSize));
+                return src.decodeChunk(entries.at(ek.first), ek.second, raw.data());
+            };
+            if (!m_encoder.repack(work, level, load, packed)) return false;
+            QSet<int> shrunk;
+            for (int w = 0; w < todo.size(); ++w) {
+                if (packed.at(w).isEmpty()) continue;
+                work[w].digest = chunks.at(todo.at(w)).digest;
+                chunks[todo.at(w)] = work.at(w);
+                stored[todo.at(w)] = packed.at(w);
+                shrunk.insert(at.at(todo.at(w)).first);
+            }
+            repacked += shrunk.size();
+
+            int j = 0;
+            for (int i = first; i < last; ++i) {
+                const VfsArchive::Entry &e = entries.at(i);
+                Pending p;
+                p.name = (e.isDir && !e.name.endsWith('/') ? e.name + '/' : e.name).toUtf8();
+                p.flags = e.isDir ? kVfsEntryDir : 0;
+                p.size = e.size;
+                p.crc = e.crc;
+                p.mtime = e.mtime;
+                for (int k = 0; k < int(e.refCount); ++k, ++j) {
+                    VfsChunk c = chunks.at(j);
+                    VfsChunk known;
+                    if (m_dedup && m_encoder.lookup(c.digest, known)) {
+                        p.chunks << m_idAt.value(known.offset);
+                        continue;
+                    }
+                    if (!storeChunk(stored.at(j), c)) return false;
+                    m_encoder.remember(c);
+                    p.chunks << m_idAt.value(c.offset);
+                }
+                m_pending << p;
+                if (op) op->advance(e.size, 1, e.name);
+            }
+            first = last;
+        }
+        return true;
+    }
+
+    // index and trailer, then the atomic rename over the target
+    bool commit() {
+        // later additions of a name replace earlier ones
+        std::stable_sort(m_pending.begin(), m_pending.end(), [](const Pending &a, const Pending &b) { return a.name < b.name; });
+        QVector<Pending> entries;
+        for (const Pending &p : m_pending) {
+            if (!entries.isEmpty() && entries.last().name == p.name) entries.last() = p;
+            else entries << p;
+        }
+
+        QVector<QByteArray> names;
+        QByteArray namePool;
+        QVector<quint32> refs;
+        for (const Pending &p : entries) names << p.name;
+        QVector<quint32> displacements, slotTable;
+        quint32 seed = 0;
+        while (!buildVfsPerfectHash(names, seed, displacements, slotTable)) {
+            if (++seed == 64) return false;
+        }
+
+        QByteArray index(kVfsIndexHeaderSize, '\0');
+        qToLittleEndian<quint32>(quint32(entries.size()), index.data());
+        qToLittleEndian<quint32>(quint32(m_chunks.size()), index.data() + 4);
+        qToLittleEndian<quint32>(quint32(displacements.size()), index.data() + 12);
+        qToLittleEndian<quint32>(quint32(slotTable.size()), index.data() + 16);
+        qToLittleEndian<quint32>(seed, index.data() + 20);
+        for (const Pending &p : entries) {
+            char r[kVfsEntryRecordSize] = {};
+            qToLittleEndian<quint64>(quint64(namePool.size()), r);
+            qToLittleEndian<quint32>(quint32(p.name.size()), r + 8);
+            qToLittleEndian<quint32>(p.flags, r + 12);
+            qToLittleEndian<quint64>(quint64(p.size), r + 16);
+            qToLittleEndian<quint32>(quint32(refs.size()), r + 24);
+            qToLittleEndian<quint32>(quint32(p.chunks.size()), r + 28);
+            qToLittleEndian<quint32>(p.crc, r + 32);
+            qToLittleEndian<quint64>(quint64(p.mtime), r + 40);
+            index.append(r, sizeof(r));
+            namePool += p.name;
+            refs += p.chunks;
+        }
+        for (const VfsChunk &c : m_chunks) c.appendTo(index);
+        if (m_dedup) {
+            for (const VfsChunk &c : m_chunks) index += c.digest;
+        }
+        qToLittleEndian<quint32>(quint32(refs.size()), index.data() + 8);
+        qToLittleEndian<quint64>(quint64(namePool.size()), index.data() + 24);
+        qToLittleEndian<quint64>(quint64(m_manifest.size()), index.data() + 32);
+        qToLittleEndian<quint32>(quint32(m_dict.size()), index.data() + 40);
+        auto appendWords = [&index](const QVector<quint32> &words) {
+            for (quint32 w : words) {
+                char b[4];
+                qToLittleEndian<quint32>(w, b);
+                index.append(b, 4);
+            }
+            index.append(int(vfsAlign8(index.size()) - index.size()), '\0');
+        };
+        appendWords(refs);
+        appendWords(displacements);
+        appendWords(slotTable);
+        index += namePool;
+        index.append(int(vfsAlign8(index.size()) - index.size()), '\0');
+        index += m_manifest;
+        index.append(int(vfsAlign8(index.size()) - index.size()), '\0');
+        index += m_dict;
+        // padded so the trailer, and every trailer appended after it, sits on an 8-byte boundary
+        index.append(int(vfsAlign8(index.size()) - index.size()), '\0');
+
+        // the index starts 8-aligned so its records are naturally aligned in the mapping
+        if (!write(QByteArray(int(vfsAlign8(m_pos) - m_pos), '\0'))) return false;
+        VfsTrailer trailer;
+        trailer.indexOffset = m_pos;
+        trailer.indexSize = index.size();
+        trailer.indexCrc = quint32(crc32(0, reinterpret_cast<const Bytef*>(index.constData()), uInt(index.size())));
+        return write(index) && write(trailer.encode()) && m_file.commit();
+    }
+
+    void cancel() { m_file.cancelWriting(); }
+
+private:
+    struct Pending {
+        QByteArray name;
+        quint32 flags = 0;
+        qint64 size = 0;
+        quint32 crc = 0;
+        qint64 mtime = 0;
+        QVector<quint32> chunks;
+    };
+
+    bool write(const QByteArray &bytes) {
+        if (m_file.write(bytes) != bytes.size()) return false;
+        m_pos += bytes.size();
+        return true;
+    }
+
+    bool storeChunk(const QByteArray &bytes, VfsChunk &c) {
+        c.offset = m_pos;
+        if (!write(bytes)) return false;
+        m_idAt.insert(c.offset, quint32(m_chunks.size()));
+        m_chunks << c;
+        return true;
+    }
+
+    QSaveFile m_file;
+    const quint32 m_chunkSize;
+    const bool m_dedup;
+    VfsKey m_key;
+    VfsChunkEncoder m_encoder;
+    qint64 m_pos = 0;
+    QByteArray m_manifest;
+    QByteArray m_dict;
+    QVector<Pending> m_pending;
+    QVector<VfsChunk> m_chunks;
+    QHash<qint64, quint32> m_idAt;   // chunk id by file offset
+};
+
+// one edit appended to an existing archive in place: new chunks, then a log record naming
+// what was added, replaced or removed, then a fresh trailer. Nothing already in the file is
+// rewritten, so the cost of an edit is the size of the edit, not of the archive.
+class VfsLogAppender {
+public:
+    explicit VfsLogAppender(const VfsArchive &archive)
+        : m_archive(archive), m_file(archive.path()), m_encoder(archive.chunkSize(), archive.isDeduplicated()) {}
+
+    bool open() {
+        if (!m_encoder.isValid() || (m_archive.isEncrypted() && m_archive.key().isNull())) return false;
+        if (!m_file.open(QIODevice::ReadWrite)) return false;
+        m_encoder.setKey(m_archive.key());
+        // whatever a torn append left behind the last good trailer goes
+        m_pos = m_archive.end();
+        for (const VfsChunk &c : m_archive.knownChunks()) m_encoder.remember(c);
+        return m_encoder.setDictionary(m_archive.dictionary()) && m_file.resize(m_pos) && m_file.seek(m_pos);
+    }
+
+    void setManifest(const QByteArray &json) {
+        m_manifest = json;
+        m_hasManifest = true;
+    }
+
+    // an archive gets one dictionary, with the first edit that has enough small files to train it.
+    // Encrypted archives get none, it would hold their content in the clear.
+    bool setDictionary(const QByteArray &dict) {
+        if (m_archive.isEncrypted() || !m_archive.dictionary().isEmpty() || !m_encoder.setDictionary(dict)) return false;
+        m_dict = dict;
+        return true;
+    }
+
+    bool addDirectory(const QString &name, qint64 mtime) {
+        Added a;
+        a.name = (name.endsWith('/') ? name : name + '/').toUtf8();
+        a.flags = kVfsEntryDir;
+        a.mtime = mtime;
+        m_added << a;
+        return true;
+    }
+
+    // contents, when given, are the source's bytes already read (for dictionary training), so
+    // the file isn't read a second time
+    bool addFile(const QString &name, const QString &source, ArchiveOperation *op = nullptr, const QByteArray *contents = nullptr) {
+        QFile file(source);
+        QBuffer buffer;
+        QIODevice *in = &file;
+        if (contents) {
+            buffer.setData(*contents);
+            in = &buffer;
+        }
+        if (!in->open(QIODevice::ReadOnly)) return false;
+        if (!contents) adviseSequentialRead(file.handle(), 0, file.size());
+        Added a;
+        a.name = name.toUtf8();
+        a.mtime = QFileInfo(source).lastModified().toMSecsSinceEpoch();
+        auto store = [this](const QByteArray &bytes, VfsChunk &c) {
+            c.offset = m_pos;
+            return write(bytes);
+        };
+        if (!m_encoder.encode(*in, store, a.chunks, a.size, a.crc, op)) return false;
+        m_added << a;
+        return true;
+    }
+
+    // e is being replaced: its chunks stay in the file, dead unless something else points at them
+    void supersede(const VfsArchive::Entry &e) {
+        VfsChunk c;
+        for (int k = 0; k < int(e.refCount); ++k) {
+            if (m_archive.chunkFor(e, k, c)) m_dropped.insert(c.offset, c.storedSize);
+        }
+    }
+
+    void remove(const VfsArchive::Entry &e) {
+        supersede(e);
+        m_removed << (e.isDir && !e.name.endsWith('/') ? e.name + '/' : e.name).toUtf8();
+    }
+
+    // chunks, record, sync, trailer, sync: the trailer only reaches the disk after everything it points at
+    bool commit() {
+        if (!write(QByteArray(int(vfsAlign8(m_pos) - m_pos), '\0'))) return false;
+        const VfsTrailer &prev = m_archive.trailer();
+        QByteArray rec(kVfsLogHeaderSize, '\0');
+        memcpy(rec.data(), kVfsLogMagic, sizeof(kVfsLogMagic));
+        qToLittleEndian<quint64>(quint64(prev.logOffset), rec.data() + 8);
+        qToLittleEndian<quint64>(quint64(prev.logSize), rec.data() + 16);
+        qToLittleEndian<quint32>(quint32(m_added.size()), rec.data() + 24);
+        qToLittleEndian<quint32>(quint32(m_removed.size()), rec.data() + 28);
+        qToLittleEndian<quint64>(quint64(m_hasManifest ? m_manifest.size() : 0), rec.data() + 32);
+        qToLittleEndian<quint32>(quint32(m_dict.size()), rec.data() + 40);
+        for (const Added &a : m_added) {
+            char r[kVfsLogEntrySize] = {};
+            qToLittleEndian<quint32>(quint32(a.name.size()), r);
+            qToLittleEndian<quint32>(a.flags, r + 4);
+            qToLittleEndian<quint64>(quint64(a.size), r + 8);
+            qToLittleEndian<quint32>(a.crc, r + 16);
+            qToLittleEndian<quint32>(quint32(a.chunks.size()), r + 20);
+            qToLittleEndian<quint64>(quint64(a.mtime), r + 24);
+            rec.append(r, sizeof(r));
+            rec += a.name;
+            for (const VfsChunk &c : a.chunks) {
+                c.appendTo(rec);
+                if (m_archive.isDeduplicated()) rec += c.digest;
+            }
+        }
+        for (const QByteArray &name : m_removed) {
+            char len[4];
+            qToLittleEndian<quint32>(quint32(name.size()), len);
+            rec.append(len, 4);
+            rec += name;
+        }
+        if (m_hasManifest) rec += m_manifest;
+        rec += m_dict;
+        char crc[4];
+        qToLittleEndian<quint32>(quint32(crc32(0, reinterpret_cast<const Bytef*>(rec.constData()), uInt(rec.size()))), crc);
+        rec.append(crc, 4);
+
+        VfsTrailer trailer = prev;
+        trailer.logOffset = m_pos;
+        trailer.logSize = rec.size();
+        // chunks the new entries share with replaced ones stay live. Sharing with entries this edit
+        // doesn't touch isn't tracked, so with dedup the count is an upper bound; compaction is
+        // what finds out.
+        for (const Added &a : m_added) {
+            for (const VfsChunk &c : a.chunks) m_dropped.remove(c.offset);
+        }
+        for (quint32 stored : m_dropped) trailer.garbage += stored;
+        // the trailer this one supersedes is dead weight as well
+        trailer.garbage += kVfsTrailerSize;
+        if (!write(rec) || !write(QByteArray(int(vfsAlign8(m_pos) - m_pos), '\0')) || !syncVfsFile(m_file)) return false;
+        return write(trailer.encode()) && syncVfsFile(m_file);
+    }
+
+    // back to the archive as it was
+    void cancel() {
+        if (m_file.isOpen()) m_file.resize(m_archive.end());
+        m_file.close();
+    }
+
+private:
+    struct Added {
+        QByteArray name;
+        quint32 flags = 0;
+        qint64 size = 0;
+        quint32 crc = 0;
+        qint64 mtime = 0;
+        QVector<VfsChunk> chunks;
+    };
+
+    bool write(const QByteArray &bytes) {
+        if (m_file.write(bytes) != bytes.size()) return false;
+        m_pos += bytes.size();
+        return true;
+    }
+
+    const VfsArchive &m_archive;
+    QFile m_file;
+    qint64 m_pos = 0;
+    VfsChunkEncoder m_encoder;
+    QHash<qint64, quint32> m_dropped;   // stored size of superseded chunks, by offset
+    QByteArray m_manifest;
+    bool m_hasManifest = false;
+    QByteArray m_dict;
+    QVector<Added> m_added;
+    QVector<QByteArray> m_removed;
+};
+
+// the manifest every new archive starts with; loadMetadata() reads it back as .manifest.json
+static QByteArray defaultVfsManifest() {
+    QJsonObject o{{"version", "1.0"}, {"created", QDateTime::currentDateTime().toString(Qt::ISODate)},
+                  {"tags", QJsonArray::fromStringList(QStringList() << "new")}};
+    return QJsonDocument(o).toJson();
+}
+
+static bool createEmptyVfsArchive(const QString &path, bool dedup = false, const QString &password = QString()) {
+    VfsArchiveWriter writer(path, kVfsChunkSize, dedup);
+    if (!password.isEmpty()) {
+        const VfsKey key = VfsKey::create(password);
+        if (key.isNull()) return false;
+        writer.setKey(key);
+    }
+    if (!writer.open()) return false;
+    writer.setManifest(defaultVfsManifest());
+    return writer.commit();
+}
+
+// seekable stream over one entry; a seek decodes only the chunk it lands in
+class VfsEntryDevice : public QIODevice {
+public:
+    VfsEntryDevice(const QSharedPointer<const VfsArchive> &archive, const VfsArchive::Entry &entry, QObject *parent = nullptr)
+        : QIODevice(parent), m_archive(archive), m_entry(entry), m_starts(archive->chunkStarts(entry)) {}
+
+    bool open(OpenMode mode) override {
+        if ((mode & WriteOnly) || m_entry.isDir) return false;
+        m_pos = 0;
+        m_cached = -1;
+        return QIODevice::open(mode | QIODevice::Unbuffered);
+    }
+
+    bool isSequential() const override { return false; }
+    qint64 size() const override { return m_entry.size; }
+
+    bool seek(qint64 pos) override {
+        if (pos < 0 || pos > m_entry.size) return false;
+        m_pos = pos;
+        return QIODevice::seek(pos);
+    }
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override {
+        maxSize = qMin(maxSize, m_entry.size - m_pos);
+        if (maxSize <= 0) return 0;
+        const int k = int(std::upper_bound(m_starts.begin(), m_starts.end(), m_pos) - m_starts.begin()) - 1;
+        VfsChunk c;
+        if (!m_archive->chunkFor(m_entry, k, c)) return -1;
+        if (k != m_cached) {
+            m_chunk.resize(int(c.rawSize));
+            if (!m_archive->decodeChunk(m_entry, k, m_chunk.data())) return -1;
+            m_cached = k;
+        }
+        const qint64 inner = m_pos - m_starts.at(k);
+        const qint64 n = qMin<qint64>(maxSize, m_chunk.size() - inner);
+        if (n <= 0) return -1;
+        memcpy(data, m_chunk.constData() + inner, size_t(n));
+        m_pos += n;
+        return n;
+    }
+    qint64 writeData(const char *, qint64) override { return -1; }
+
+private:
+    QSharedPointer<const VfsArchive> m_archive;
+    const VfsArchive::Entry m_entry;
+    const QVector<qint64> m_starts;
+    qint64 m_pos = 0;
+    int m_cached = -1;
+    QByteArray m_chunk;
 };
 
-// --- CLI fallback ArchiveHandler implementation ---
-class CliArchiveHandler : public ArchiveHandler {
+// every chunk of every selected file is its own job: workers decode chunks in any order and
+// write each where it starts in the file; whichever worker finishes the last chunk of a file closes it
+static bool extractVfsEntries(const QSharedPointer<const VfsArchive> &archive, const QVector<VfsArchive::Entry> &entries,
+                              const QString &destDir, ArchiveOperation *op) {
+    const QDir dest(destDir);
+    QVector<QPair<int, int>> units;   // (entry, chunk)
+    QVector<int> remaining(entries.size(), 0);
+    QVector<QVector<qint64>> starts(entries.size());
+    for (int i = 0; i < entries.size(); ++i) {
+        const VfsArchive::Entry &e = entries.at(i);
+        if (!isSafeEntryPath(e.name)) return false;
+        const QString outPath = dest.filePath(e.name);
+        if (e.isDir) {
+            QDir().mkpath(outPath);
+            if (op) op->advance(0, 1, e.name);
+            continue;
+        }
+        QDir().mkpath(QFileInfo(outPath).absolutePath());
+        if (e.refCount == 0) {
+            QFile out(outPath);
+            if (!out.open(QIODevice::WriteOnly | QIODevice::Truncate)) return false;
+            if (op) op->advance(0, 1, e.name);
+            continue;
+        }
+        for (int k = 0; k < int(e.refCount); ++k) units << qMakePair(i, k);
+        remaining[i] = int(e.refCount);
+        starts[i] = archive->chunkStarts(e);
+    }
+
+    QScopedPointer<IoEngine> io(IoEngine::create());
+    QMutex fileMutex;
+    QVector<int> handles(entries.size(), -1);
+    QAtomicInt next(0);
+    QAtomicInt failed(0);
+    auto work = [&]() {
+        for (;;) {
+            const int u = next.fetchAndAddRelaxed(1);
+            if (u >= units.size() || failed.load() || (op && op->isCancelled())) return;
+            const int i = units.at(u).first;
+            const int k = units.at(u).second;
+            const VfsArchive::Entry &e = entries.at(i);
+            VfsChunk c;
+            if (!archive->chunkFor(e, k, c)) { failed.store(1); return; }
+            QByteArray data(int(c.rawSize), Qt::Uninitialized);
+            if (!archive->decodeChunk(e, k, data.data())) { failed.store(1); return; }
+            QMutexLocker lock(&fileMutex);
+            if (handles.at(i) < 0) handles[i] = io->open(dest.filePath(e.name));
+            const int handle = handles.at(i);
+            lock.unlock();
+            if (handle < 0 || !io->write(handle, starts.at(i).at(k), data)) { failed.store(1); return; }
+            if (op) op->advance(c.rawSize);
+            lock.relock();
+            if (--remaining[i] > 0) continue;
+            handles[i] = -1;
+            lock.unlock();
+            io->close(handle, true);
+            if (op) op->advance(0, 1, e.name);
+        }
+    };
+
+    QThreadPool workers;
+    const int threads = qMin(qMax(1, QThread::idealThreadCount()), units.size());
+    workers.setMaxThreadCount(qMax(1, threads));
+    for (int t = 0; t < threads; ++t) workers.start(new FunctionRunnable(work));
+    workers.waitForDone();
+
+    const bool ok = !failed.load() && !(op && op->isCancelled());
+    // files left unfinished by a failure or cancel are removed
+    for (int i = 0; i < handles.size(); ++i) {
+        if (handles.at(i) >= 0) io->close(handles.at(i), false);
+    }
+    return io->flush() && ok;
+}
+
+class VfsArchiveHandler : public CliArchiveHandler {
 public:
-    CliArchiveHandler(QObject *parent = nullptr) : ArchiveHandler(parent) {}
-    ~CliArchiveHandler() override {}
+    VfsArchiveHandler(QObject *parent = nullptr) : CliArchiveHandler(parent) {}
+
+    // by content: older .vfsarc files are renamed zips and stay with the zip handlers
+    static bool handles(const QString &path) { return !path.isEmpty() && VfsArchive::isVfsArchive(path); }
 
     bool openArchive(const QString &path) override {
-        m_archive = path;
-        return QFile::exists(path);
+        if (!CliArchiveHandler::openArchive(path)) return false;
+        return reload();
     }
-    QString archivePath() const override { return m_archive; }
 
-    // note: returns entries optionally filtered by prefix
     QStringList listEntries(const QString &prefix = QString()) const override {
-        QStringList entries;
-        QProcess p;
-        QStringList args;
-        args << "-Z" << "-1" << m_archive;
-        if (!m_password.isEmpty()) {
-            // unzip: -P password (note: insecure on CLI, but ok for demo)
-            args.prepend(m_password);
-            args.prepend("-P");
+        const QSharedPointer<const VfsArchive> a = archive();
+        return a ? a->names(prefix) : QStringList();
+    }
+
+    bool extractEntryToTemp(const QString &entry, QString &outPath) override {
+        const QSharedPointer<const VfsArchive> a = archive();
+        if (!a || !isSafeEntryPath(entry)) return false;
+        const QString tmp = QDir::temp().filePath(QString("qt_arch_tmp_%1").arg(QUuid::createUuid().toString()));
+        const QString target = QDir(tmp).filePath(entry);
+        VfsArchive::Entry e;
+        if (!a->find(entry, e)) {
+            // the manifest lives in the index rather than as an entry
+            if (entry != ".manifest.json" || a->manifest().isEmpty()) return false;
+            QDir().mkpath(tmp);
+            QFile f(target);
+            if (!f.open(QIODevice::WriteOnly) || f.write(a->manifest()) != a->manifest().size()) return false;
+            outPath = target;
+            return true;
         }
-        p.start("unzip", args);
-        p.waitForFinished(3000);
+        if (!extractVfsEntries(a, {e}, tmp, nullptr)) return false;
+        outPath = target;
+        return true;
+    }
 
-        // if exit code non-zero and output empty, we may have a password issue
-        QByteArray out = p.readAllStandardOutput();
-        QByteArray err = p.readAllStandardError();
-        QTextStream ts(out);
-        while (!ts.atEnd()) {
-            QString line = ts.readLine().trimmed();
-            if (!line.isEmpty()) {
-                if (prefix.isEmpty() || line.startsWith(prefix)) entries << line;
-            }
+    bool extractAll(const QString &destDir, ArchiveOperation *op = nullptr) override {
+        const QSharedPointer<const VfsArchive> a = archive();
+        if (!a) return false;
+        return extract(a, a->entries(), destDir, op);
+    }
+
+    bool extractEntries(const QStringList &names, const QString &destDir, ArchiveOperation *op = nullptr) override {
+        const QSharedPointer<const VfsArchive> a = archive();
+        if (!a) return false;
+        QVector<VfsArchive::Entry> entries;
+        for (const QString &name : names) {
+            VfsArchive::Entry e;
+            if (!a->find(name, e)) return false;
+            entries << e;
         }
-        return entries;
+        return extract(a, entries, destDir, op);
     }
 
-    bool extractEntryToTemp(const QString &entry, QString &outPath) override {
-        QString persistentTmp = QDir::temp().filePath(QString("qt_arch_tmp_%1").arg(QUuid::createUuid().toString()));
-        QDir().mkpath(persistentTmp);
-        QProcess p;
-        QStringList args;
-        if (!m_password.isEmpty()) { args << "-P" << m_password; }
-        args << m_archive << entry << "-d" << persistentTmp;
-        p.start("unzip", args);
-        p.waitForFinished(-1);
-        if (p.exitCode() == 0) {
-            outPath = QDir(persistentTmp).filePath(entry);
+    bool addFiles(const QStringList &files, const QString &destPathInArchive, ArchiveOperation *op = nullptr) override {
+        QVector<QPair<QString, QString>> added;
+        qint64 bytes = 0;
+        collectAdditions(files, destPathInArchive, added, bytes);
+        if (op) op->begin(added.size(), bytes);
+        return appendEdit(op, [&added, op](const VfsArchive &a, VfsLogAppender &log) {
+            QHash<QString, QByteArray> sampled;
+            if (a.dictionary().isEmpty() && !a.isEncrypted()) {
+                QStringList sources;
+                for (const QPair<QString, QString> &p : added) sources << p.second;
+                const QByteArray dict = trainVfsDictionary(sources, &sampled);
+                if (!dict.isEmpty() && !log.setDictionary(dict)) return false;
+            }
+            for (const QPair<QString, QString> &p : added) {
+                if (op && op->isCancelled()) return false;
+                VfsArchive::Entry old;
+                if (a.find(p.first, old)) log.supersede(old);
+                const bool ok = p.first.endsWith('/')
+                    ? log.addDirectory(p.first, QFileInfo(p.second).lastModified().toMSecsSinceEpoch())
+                    : log.addFile(p.first, p.second, op, sampled.contains(p.second) ? &sampled[p.second] : nullptr);
+                if (!ok) return false;
+                if (op) op->advance(0, 1, p.first);
+            }
             return true;
-        }
-        return false;
+        });
     }
 
-    bool extractAll(const QString &destDir) override {
-        QProcess p;
-        QStringList args;
-        if (!m_password.isEmpty()) { args << "-P" << m_password; }
-        args << m_archive << "-d" << destDir;
-        p.start("unzip", args);
-        p.waitForFinished(-1);
-        return p.exitCode() == 0;
+    bool removeEntries(const QStringList &entries, ArchiveOperation *op = nullptr) override {
+        if (op) op->begin(entries.size(), 0);
+        return appendEdit(op, [&entries, op](const VfsArchive &a, VfsLogAppender &log) {
+            for (const QString &name : entries) {
+                VfsArchive::Entry e;
+                if (a.find(name, e)) log.remove(e);
+                if (op) op->advance(0, 1, name);
+            }
+            return true;
+        });
     }
 
-    bool addFiles(const QStringList &files, const QString &) override {
-        // zip archive.zip files...
-        QStringList args;
-        args << m_archive;
-        for (const QString &f : files) args << f;
-        QProcess p;
-        p.start("zip", args);
-        p.waitForFinished(-1);
-        return p.exitCode() == 0;
+    // an empty folder is a directory entry, no placeholder file needed
+    bool addDirectory(const QString &name) {
+        return appendEdit(nullptr, [&name](const VfsArchive &, VfsLogAppender &log) {
+            return log.addDirectory(name, QDateTime::currentMSecsSinceEpoch());
+        });
     }
 
-    bool removeEntries(const QStringList &entries) override {
-        QStringList args;
-        args << m_archive;
-        for (const QString &e : entries) args << e;
-        QProcess p;
-        p.start("zip", QStringList{"-d"} + args);
-        p.waitForFinished(-1);
-        return p.exitCode() == 0;
+    bool setManifest(const QByteArray &json) {
+        return appendEdit(nullptr, [&json](const VfsArchive &, VfsLogAppender &log) {
+            log.setManifest(json);
+            return true;
+        });
     }
 
-    void setPassword(const QString &pw) override { m_password = pw; }
+    void setPassword(const QString &password) override { unlock(password); }
+
+    bool isEncrypted() const {
+        const QSharedPointer<const VfsArchive> a = archive();
+        return a && a->isEncrypted();
+    }
+
+    // names stay readable without the password, contents don't
+    bool unlock(const QString &password) {
+        QMutexLocker edit(&m_editMutex);
+        const QSharedPointer<const VfsArchive> a = archive();
+        if (!a) return false;
+        if (!a->isEncrypted() || (!a->key().isNull() && password == m_password)) return true;
+        QSharedPointer<VfsArchive> fresh(new VfsArchive);
+        if (!fresh->open(archivePath()) || !fresh->setKey(fresh->deriveKey(password))) return false;
+        QWriteLocker lock(&m_lock);
+        m_password = password;
+        m_key = fresh->key();
+        m_archive = fresh;
+        return true;
+    }
+
+    QIODevice *openEntryDevice(const QString &entry) override {
+        const QSharedPointer<const VfsArchive> a = archive();
+        VfsArchive::Entry e;
+        if (!a || !a->find(entry, e)) return nullptr;
+        VfsEntryDevice *dev = new VfsEntryDevice(a, e);
+        if (!dev->open(QIODevice::ReadOnly)) { delete dev; return nullptr; }
+        return dev;
+    }
+
+    // once dead chunks make up enough of the file that rewriting it pays off
+    bool wantsCompaction() const {
+        const QSharedPointer<const VfsArchive> a = archive();
+        return a && a->trailer().garbage >= kVfsCompactMinGarbage && a->trailer().garbage >= qint64(a->end() * kVfsCompactRatio);
+    }
+
+    // live entries copied as stored into a fresh archive with a new index and no log. The copy
+    // runs without blocking edits; if one lands meanwhile the copy is stale and is thrown away.
+    bool compact(const CancelToken &cancel) {
+        const QSharedPointer<const VfsArchive> a = archive();
+        if (!a) return false;
+        if (a->isEncrypted() && a->key().isNull()) return false;
+        VfsArchiveWriter writer(archivePath(), a->chunkSize(), a->isDeduplicated());
+        // same salt and key: the raw copies stay valid and the password doesn't change
+        if (a->isEncrypted()) writer.setKey(a->key());
+        if (!writer.open()) return false;
+        writer.setManifest(a->manifest());
+        if (!writer.setDictionary(a->dictionary())) { writer.cancel(); return false; }
+        for (const VfsArchive::Entry &e : a->entries()) {
+            if (cancel.isCancelled() || !writer.copyEntry(*a, e)) { writer.cancel(); return false; }
+        }
+        QMutexLocker lock(&m_editMutex);
+        if (archive() != a) { writer.cancel(); return false; }
+        return writer.commit() && reload();
+    }
+
+    // every chunk is decoded on a worker pool, which checks its own crc (and, sealed, its tag);
+    // an entry's chunk crcs are then combined and held against the entry's crc and size
+    bool testArchive(TestResult &result, ArchiveOperation *op = nullptr) override {
+        QElapsedTimer clock;
+        clock.start();
+        const QSharedPointer<const VfsArchive> a = archive();
+        if (!a) return false;
+        if (a->isEncrypted() && a->key().isNull()) return false;
+        result = TestResult();
+        const QVector<VfsArchive::Entry> entries = a->entries();
+        result.entries = entries.size();
+        QVector<QPair<int, int>> chunks;   // (entry, chunk)
+        QVector<int> firstChunk;
+        for (int i = 0; i < entries.size(); ++i) {
+            firstChunk << chunks.size();
+            for (int k = 0; k < int(entries.at(i).refCount); ++k) chunks << qMakePair(i, k);
+            result.bytes += entries.at(i).size;
+        }
+        firstChunk << chunks.size();
+        if (op) op->begin(entries.size(), result.bytes);
+        QVector<quint32> crcs(chunks.size(), 0);
+        QVector<qint64> sizes(chunks.size(), -1);   // -1: didn't decode
+        parallelForEach(chunks.size(), [&](int j) {
+            if (op && op->isCancelled()) return;
+            const VfsArchive::Entry &e = entries.at(chunks.at(j).first);
+            VfsChunk c;
+            if (!a->chunkFor(e, chunks.at(j).second, c)) return;
+            QByteArray raw(int(c.rawSize), Qt::Uninitialized);
+            if (!a->decodeChunk(e, chunks.at(j).second, raw.data())) return;
+            crcs[j] = c.crc;
+            sizes[j] = c.rawSize;
+            if (op) op->advance(c.rawSize);
+        });
+        if (op && op->isCancelled()) return false;
+        for (int i = 0; i < entries.size(); ++i) {
+            const VfsArchive::Entry &e = entries.at(i);
+            uLong crc = crc32(0, nullptr, 0);
+            qint64 total = 0;
+            bool ok = true;
+            for (int j = firstChunk.at(i); j < firstChunk.at(i + 1); ++j) {
+                // a chunk that didn't decode has no length to combine with
+                if (sizes.at(j) < 0) { ok = false; break; }
+                crc = crc32_combine(crc, crcs.at(j), sizes.at(j));
+                total += sizes.at(j);
+            }
+            if (!ok || total != e.size || quint32(crc) != e.crc) result.corrupt << e.name;
+            if (op) op->advance(0, 1, e.name);
+        }
+        result.elapsedMs = clock.elapsed();
+        if (op) op->finish();
+        return true;
+    }
+
+    // zstd at level 1-19, applied like compact(): the rewrite only lands if no edit came in meanwhile
+    bool optimize(int level, OptimizeResult &result, ArchiveOperation *op = nullptr) override {
+        if (level < 1 || level > ZSTD_maxCLevel()) return false;
+        QElapsedTimer clock;
+        clock.start();
+        const QSharedPointer<const VfsArchive> a = archive();
+        if (!a) return false;
+        if (a->isEncrypted() && a->key().isNull()) return false;
+        result = OptimizeResult();
+        result.sizeBefore = QFileInfo(archivePath()).size();
+        const QVector<VfsArchive::Entry> entries = a->entries();
+        result.entries = entries.size();
+        for (const VfsArchive::Entry &e : entries) result.bytes += e.size;
+        VfsArchiveWriter writer(archivePath(), a->chunkSize(), a->isDeduplicated());
+        if (a->isEncrypted()) writer.setKey(a->key());
+        if (!writer.open()) return false;
+        writer.setManifest(a->manifest());
+        if (!writer.setDictionary(a->dictionary())) { writer.cancel(); return false; }
+        if (op) op->begin(entries.size(), result.bytes);
+        if (!writer.recompressEntries(*a, entries, level, result.recompressed, op)) { writer.cancel(); return false; }
+        QMutexLocker lock(&m_editMutex);
+        if (archive() != a) { writer.cancel(); return false; }
+        if (!writer.commit() || !reload()) return false;
+        result.sizeAfter = QFileInfo(archivePath()).size();
+        result.elapsedMs = clock.elapsed();
+        if (op) op->finish();
+        return true;
+    }
+
+    // same chunk size, mode, key and dictionary as this archive, so every chunk is copied as stored
+    bool exportEntries(const QStringList &names, const QString &destPath, ArchiveOperation *op = nullptr) override {
+        const QSharedPointer<const VfsArchive> a = archive();
+        if (!a) return false;
+        if (a->isEncrypted() && a->key().isNull()) return false;
+        QVector<VfsArchive::Entry> entries;
+        qint64 total = 0;
+        for (const QString &name : names) {
+            VfsArchive::Entry e;
+            if (!a->find(name, e)) return false;
+            entries << e;
+            total += e.size;
+        }
+        VfsArchiveWriter writer(destPath, a->chunkSize(), a->isDeduplicated());
+        if (a->isEncrypted()) writer.setKey(a->key());
+        if (!writer.open()) return false;
+        writer.setManifest(a->manifest());
+        if (!writer.setDictionary(a->dictionary())) { writer.cancel(); return false; }
+        if (op) op->begin(entries.size(), total);
+        for (const VfsArchive::Entry &e : entries) {
+            if ((op && op->isCancelled()) || !writer.copyEntry(*a, e)) { writer.cancel(); return false; }
+            if (op) op->advance(e.size, 1, e.name);
+        }
+        if (!writer.commit()) return false;
+        if (op) op->finish();
+        return true;
+    }
 
 private:
-    QString m_archive;
+    bool reload() {
+        QSharedPointer<VfsArchive> a(new VfsArchive);
+        if (!a->open(archivePath())) return false;
+        QWriteLocker lock(&m_lock);
+        // the key derived at unlock is reused, re-deriving would stall every edit
+        if (!m_key.isNull() && !a->setKey(m_key)) return false;
+        m_archive = a;
+        return true;
+    }
+
+    QSharedPointer<const VfsArchive> archive() const {
+        QReadLocker lock(&m_lock);
+        return m_archive;
+    }
+
+    bool extract(const QSharedPointer<const VfsArchive> &a, const QVector<VfsArchive::Entry> &entries, const QString &destDir,
+                 ArchiveOperation *op) {
+        qint64 total = 0;
+        for (const VfsArchive::Entry &e : entries) total += e.size;
+        if (op) op->begin(entries.size(), total);
+        if (!extractVfsEntries(a, entries, destDir, op)) return false;
+        if (op) op->finish();
+        return true;
+    }
+
+    // (name in archive, source path) for every file and directory being added
+    static void collectAdditions(const QStringList &files, const QString &destPathInArchive,
+                                 QVector<QPair<QString, QString>> &added, qint64 &bytes) {
+        QString base = destPathInArchive;
+        while (base.endsWith('/')) base.chop(1);
+        for (const QString &f : files) {
+            const QFileInfo fi(f);
+            const QString name = base.isEmpty() ? fi.fileName() : base + '/' + fi.fileName();
+            if (!fi.isDir()) {
+                added << qMakePair(name, f);
+                bytes += fi.size();
+                continue;
+            }
+            added << qMakePair(name + '/', f);
+            QDirIterator it(f, QDir::AllEntries | QDir::NoDotAndDotDot | QDir::Hidden, QDirIterator::Subdirectories);
+            while (it.hasNext()) {
+                const QString path = it.next();
+                const QString rel = name + '/' + QDir(f).relativeFilePath(path);
+                added << qMakePair(it.fileInfo().isDir() ? rel + '/' : rel, path);
+                if (!it.fileInfo().isDir()) bytes += it.fileInfo().size();
+            }
+        }
+    }
+
+    // one log record per call; edits are serialized so each appends behind the trailer the last one wrote
+    bool appendEdit(ArchiveOperation *op, const std::function<bool(const VfsArchive &, VfsLogAppender &)> &edit) {
+        QMutexLocker lock(&m_editMutex);
+        const QSharedPointer<const VfsArchive> a = archive();
+        if (!a) return false;
+        VfsLogAppender log(*a);
+        if (!log.open()) return false;
+        if (!edit(*a, log) || !log.commit()) { log.cancel(); return false; }
+        const bool ok = reload();
+        if (ok && op) op->finish();
+        return ok;
+    }
+
+    mutable QReadWriteLock m_lock;
+    QMutex m_editMutex;
+    QSharedPointer<const VfsArchive> m_archive;
     QString m_password;
+    VfsKey m_key;
+};
+
+// --- Archive merge ---
+// several archives of one format stitched into a new one by raw copy; where a name occurs
+// more than once the policy decides, going by the modification time in each directory
+enum class MergePolicy { Newest, KeepBoth, Skip };
+
+struct MergeItem {
+    int source = 0;
+    int index = 0;      // entry within its source
+    QString name;       // name in the output
+    qint64 mtime = 0;
 };
 
+// "dir/name (n).ext"
+static QString keepBothName(const QString &name, int n) {
+    const int slash = name.lastIndexOf('/');
+    int dot = name.lastIndexOf('.');
+    if (dot <= slash + 1) dot = name.size();
+    return name.left(dot) + QString(" (%1)").arg(n) + name.mid(dot);
+}
+
+// items in source order; the result keeps that order so every source is read front to back
+static QVector<MergeItem> planMerge(const QVector<MergeItem> &items, MergePolicy policy) {
+    QHash<QString, int> taken;    // output name -> position in out
+    QVector<MergeItem> out;
+    QVector<bool> dropped;
+    for (MergeItem item : items) {
+        auto it = taken.find(item.name);
+        if (it == taken.end()) {
+            taken.insert(item.name, out.size());
+            out << item;
+            dropped << false;
+            continue;
+        }
+        // a directory is the same directory in every source
+        if (policy == MergePolicy::Skip || item.name.endsWith('/')) continue;
+        if (policy == MergePolicy::Newest) {
+            // on a tie the later source wins, as it would when extracting one over the other
+            if (item.mtime < out.at(it.value()).mtime) continue;
+            dropped[it.value()] = true;
+            it.value() = out.size();
+        } else {
+            QString name;
+            for (int n = 2; taken.contains(name = keepBothName(item.name, n)); ++n) {}
+            item.name = name;
+            taken.insert(name, out.size());
+        }
+        out << item;
+        dropped << false;
+    }
+    QVector<MergeItem> kept;
+    kept.reserve(out.size());
+    for (int i = 0; i < out.size(); ++i) {
+        if (!dropped.at(i)) kept << out.at(i);
+    }
+    return kept;
+}
+
+static bool mergeZipArchives(const QStringList &sources, const QString &dest, MergePolicy policy, ArchiveOperation *op) {
+    QVector<QVector<ZipEntryInfo>> dirs(sources.size());
+    QVector<MergeItem> items;
+    for (int s = 0; s < sources.size(); ++s) {
+        QScopedPointer<QIODevice> f(openArchiveDevice(sources.at(s)));
+        if (!f || !readZipCentralDirectory(*f, dirs[s])) return false;
+        QVector<ZipEntryInfo> &entries = dirs[s];
+        std::sort(entries.begin(), entries.end(), [](const ZipEntryInfo &a, const ZipEntryInfo &b) {
+            return a.localHeaderOffset < b.localHeaderOffset;
+        });
+        for (int i = 0; i < entries.size(); ++i) {
+            MergeItem item;
+            item.source = s;
+            item.index = i;
+            item.name = entries.at(i).name;
+            item.mtime = entries.at(i).dosDateTime;   // date << 16 | time orders like the time it encodes
+            items << item;
+        }
+    }
+    const QVector<MergeItem> plan = planMerge(items, policy);
+    qint64 total = 0;
+    for (const MergeItem &item : plan) total += dirs.at(item.source).at(item.index).compressedSize;
+
+    ZipRawWriter writer(dest);
+    if (!writer.open()) return false;
+    if (op) op->begin(plan.size(), total);
+    QScopedPointer<QIODevice> src;
+    int open = -1;
+    for (const MergeItem &item : plan) {
+        if (item.source != open) {
+            src.reset(openArchiveDevice(sources.at(item.source)));
+            open = item.source;
+            if (!src) { writer.cancel(); return false; }
+        }
+        const ZipEntryInfo &info = dirs.at(item.source).at(item.index);
+        if (!writer.copyEntry(*src, info, op, item.name)) { writer.cancel(); return false; }
+        if (op) op->advance(0, 1, item.name);
+    }
+    if (!writer.commit()) return false;
+    if (op) op->finish();
+    return true;
+}
+
+// the output takes the first source's chunk size, mode, key, manifest and dictionary; chunks
+// from a source sealed under another key or packed against another dictionary are the only
+// ones decoded and encoded again
+static bool mergeVfsArchives(const QStringList &sources, const QString &dest, MergePolicy policy,
+                             const QMap<QString, QString> &passwords, ArchiveOperation *op) {
+    QVector<QSharedPointer<VfsArchive>> archives;
+    QVector<QVector<VfsArchive::Entry>> dirs;
+    QVector<MergeItem> items;
+    for (int s = 0; s < sources.size(); ++s) {
+        QSharedPointer<VfsArchive> a(new VfsArchive);
+        if (!a->open(sources.at(s))) return false;
+        if (a->isEncrypted() && !a->setKey(a->deriveKey(passwords.value(sources.at(s))))) return false;
+        if (a->chunkSize() != archives.value(0, a)->chunkSize()) return false;
+        // the output is sealed only if the first source is, and protected content must stay protected
+        if (a->isEncrypted() && !archives.value(0, a)->isEncrypted()) return false;
+        archives << a;
+        dirs << a->entries();
+        for (int i = 0; i < dirs.last().size(); ++i) {
+            MergeItem item;
+            item.source = s;
+            item.index = i;
+            item.name = dirs.last().at(i).name;
+            item.mtime = dirs.last().at(i).mtime;
+            items << item;
+        }
+    }
+    if (archives.isEmpty()) return false;
+    const QVector<MergeItem> plan = planMerge(items, policy);
+    qint64 total = 0;
+    for (const MergeItem &item : plan) total += dirs.at(item.source).at(item.index).size;
+
+    const VfsArchive &first = *archives.first();
+    VfsArchiveWriter writer(dest, first.chunkSize(), first.isDeduplicated());
+    if (first.isEncrypted()) writer.setKey(first.key());
+    if (!writer.open()) return false;
+    writer.setManifest(first.manifest());
+    if (!writer.setDictionary(first.dictionary())) { writer.cancel(); return false; }
+    if (op) op->begin(plan.size(), total);
+    for (const MergeItem &item : plan) {
+        VfsArchive::Entry e = dirs.at(item.source).at(item.index);
+        e.name = item.name;
+        if ((op && op->isCancelled()) || !writer.copyEntry(*archives.at(item.source), e)) { writer.cancel(); return false; }
+        if (op) op->advance(e.size, 1, e.name);
+    }
+    if (!writer.commit()) return false;
+    if (op) op->finish();
+    return true;
+}
+
+// every source must be of the output's format: all .vfsarc or all zip
+static bool mergeArchives(const QStringList &sources, const QString &dest, MergePolicy policy,
+                          const QMap<QString, QString> &passwords, ArchiveOperation *op = nullptr) {
+    int vfs = 0;
+    for (const QString &s : sources) {
+        if (TarArchiveHandler::handles(s)) return false;
+        if (VfsArchiveHandler::handles(s)) ++vfs;
+    }
+    if (sources.isEmpty() || dest.endsWith(".vfsarc", Qt::CaseInsensitive) != (vfs > 0)) return false;
+    if (vfs == sources.size()) return mergeVfsArchives(sources, dest, policy, passwords, op);
+    return vfs == 0 && mergeZipArchives(sources, dest, policy, op);
+}
+
+// --- Backend selection ---
+// by what the file is: native container, tar family, split zip set, otherwise zip
+static ArchiveHandler *createArchiveHandler(const QString &path) {
+    if (VfsArchiveHandler::handles(path)) return new VfsArchiveHandler;
+    if (TarArchiveHandler::handles(path)) return new TarArchiveHandler;
+    if (SplitZipArchiveHandler::handles(path)) return new SplitZipArchiveHandler;
+    return new NativeArchiveHandler;
+}
+
 // --- Archive model ---
 struct ArchiveItem {
     enum class NodeType { File, Folder, ArchiveFolder };
@@ -150,6 +5500,16 @@ public:
     // populate only items from the entries list (flat) - used for initial root population
     void populateFromList(const QStringList &entries, const QString &prefix = QString(), ArchiveItem *parentNode = nullptr) {
         if (!parentNode) parentNode = root;
+        // name -> child per node touched, so wide directories don't turn this quadratic
+        QHash<ArchiveItem*, QHash<QString, ArchiveItem*>> childIndex;
+        auto childrenOf = [&childIndex](ArchiveItem *node) -> QHash<QString, ArchiveItem*> & {
+            auto it = childIndex.find(node);
+            if (it == childIndex.end()) {
+                it = childIndex.insert(node, QHash<QString, ArchiveItem*>());
+                for (ArchiveItem *ch : node->children) it->insert(ch->name, ch);
+            }
+            return *it;
+        };
         for (const QString &e : entries) {
             if (!prefix.isEmpty() && !e.startsWith(prefix)) continue;
             QString rel = prefix.isEmpty() ? e : e.mid(prefix.length());
@@ -158,20 +5518,22 @@ public:
             QString accum = prefix;
             for (int i = 0; i < parts.size(); ++i) {
                 QString part = parts[i];
-                bool found = false;
-                for (ArchiveItem *ch : cur->children) {
-                    if (ch->name == part) { cur = ch; found = true; break; }
-                }
-                if (!found) {
+                QHash<QString, ArchiveItem*> &known = childrenOf(cur);
+                ArchiveItem *existing = known.value(part);
+                // track the path through existing nodes too, or children created under them get a truncated one
+                accum = accum.isEmpty() ? part : accum + "/" + part;
+                if (existing) {
+                    cur = existing;
+                } else {
                     ArchiveItem *it = new ArchiveItem();
                     it->name = part;
                     it->parent = cur;
-                    accum = accum.isEmpty() ? part : accum + "/" + part;
                     it->fullPathInArchive = accum;
                     it->type = (i < parts.size() - 1 || e.endsWith('/'))
                                ? ArchiveItem::NodeType::Folder
                                : (part.endsWith(".vfsarc", Qt::CaseInsensitive) ? ArchiveItem::NodeType::ArchiveFolder : ArchiveItem::NodeType::File);
                     cur->children << it;
+                    known.insert(part, it);
                     cur = it;
                 }
             }
@@ -280,6 +5642,11 @@ static ArchiveMetadata loadMetadata(ArchiveHandler *backend) {
         meta.created = QDateTime::currentDateTime().toString(Qt::ISODate);
         meta.tags = QStringList() << "new";
         QJsonObject o{{"version", meta.version}, {"created", meta.created}, {"tags", QJsonArray::fromStringList(meta.tags)}};
+        // a native container keeps its manifest in the index rather than as an entry
+        if (VfsArchiveHandler *vfs = dynamic_cast<VfsArchiveHandler*>(backend)) {
+            vfs->setManifest(QJsonDocument(o).toJson());
+            return meta;
+        }
         QTemporaryFile tmp;
         tmp.open();
         tmp.write(QJsonDocument(o).toJson());
@@ -289,6 +5656,82 @@ static ArchiveMetadata loadMetadata(ArchiveHandler *backend) {
     return meta;
 }
 
+// --- Speculative prefetch into the preview cache ---
+// decodes the selected entry and its neighbours as a Background-class job so the
+// following double-click is served from disk cache. Each prefetch() call cancels
+// the previous batch; entries already cached are skipped. The cache lives in a
+// shared state object so a job still finishing after the prefetcher is gone
+// writes into a directory that still exists.
+class EntryPrefetcher {
+public:
+    static const qint64 kMaxEntrySize = 64 * 1024 * 1024;   // bigger entries aren't worth guessing at
+    static const qint64 kCacheBudget = 256 * 1024 * 1024;
+
+    explicit EntryPrefetcher(JobScheduler *scheduler) : m_scheduler(scheduler), m_cache(new Cache) {}
+    ~EntryPrefetcher() { cancel(); }
+
+    void prefetch(const QString &archivePath, const QVector<ZipEntryInfo> &entries) {
+        cancel();
+        QSharedPointer<Cache> cache = m_cache;
+        m_token = m_scheduler->submit(JobClass::Background, [cache, archivePath, entries](const CancelToken &token) {
+            for (const ZipEntryInfo &e : entries) {
+                if (token.isCancelled()) return;
+                if (e.isDir() || !e.isNativelyReadable() || e.size > kMaxEntrySize || !isSafeEntryPath(e.name)) continue;
+                const QString key = cacheKey(archivePath, e);
+                if (!cache->path(key).isEmpty()) continue;
+                const QString out = QDir(cache->dir.path()).filePath(
+                    QCryptographicHash::hash(key.toUtf8(), QCryptographicHash::Md5).toHex() + "/" + QFileInfo(e.name).fileName());
+                if (extractZipEntryToFile(archivePath, e, out, token)) cache->insert(key, out, e.size);
+            }
+        });
+    }
+
+    void cancel() { m_token.cancel(); }
+
+    // path of an already prefetched copy of this very entry, or empty
+    QString cachedPath(const QString &archivePath, const ZipEntryInfo &entry) const {
+        return m_cache->path(cacheKey(archivePath, entry));
+    }
+
+private:
+    struct Cache {
+        QTemporaryDir dir;
+        mutable QMutex mutex;
+        QHash<QString, QString> paths;
+        QHash<QString, qint64> sizes;
+        QStringList order;
+        qint64 bytes = 0;
+
+        QString path(const QString &key) const {
+            QMutexLocker lock(&mutex);
+            return paths.value(key);
+        }
+
+        void insert(const QString &key, const QString &file, qint64 size) {
+            QMutexLocker lock(&mutex);
+            paths.insert(key, file);
+            sizes.insert(key, size);
+            order << key;
+            bytes += size;
+            // drop the oldest prefetches once over budget
+            while (bytes > kCacheBudget && order.size() > 1) {
+                const QString old = order.takeFirst();
+                QFile::remove(paths.take(old));
+                bytes -= sizes.take(old);
+            }
+        }
+    };
+
+    // the name alone would hand out a stale copy once an edit replaces the entry
+    static QString cacheKey(const QString &archivePath, const ZipEntryInfo &e) {
+        return QString("%1\n%2\n%3:%4:%5").arg(archivePath, e.name).arg(e.localHeaderOffset).arg(e.crc).arg(e.compressedSize);
+    }
+
+    JobScheduler *m_scheduler;
+    QSharedPointer<Cache> m_cache;
+    CancelToken m_token;
+};
+
 // Forward declare MainWindow
 // main.cpp - Part 2/2
 // Qt 5.12 single-file demo (part 2)
@@ -296,7 +5739,7 @@ static ArchiveMetadata loadMetadata(ArchiveHandler *backend) {
 class MainWindow : public QMainWindow {
     Q_OBJECT
 public:
-    MainWindow() {
+    MainWindow() : prefetcher(&scheduler) {
         setWindowTitle("Qt Virtual Archive Browser");
         resize(1100, 650);
 
@@ -312,15 +5755,28 @@ public:
         archiveView->setModel(archiveModel);
         archiveView->setHeaderHidden(true);
         archiveView->setContextMenuPolicy(Qt::CustomContextMenu);
+        archiveView->setSelectionMode(QAbstractItemView::ExtendedSelection);
 
         connect(archiveView, &QTreeView::doubleClicked, this, &MainWindow::onArchiveDoubleClicked);
         connect(archiveView, &QTreeView::customContextMenuRequested, this, &MainWindow::onArchiveContextMenu);
         connect(archiveView, &QTreeView::expanded, this, &MainWindow::onArchiveExpanded);
         connect(archiveView, &QTreeView::collapsed, this, &MainWindow::onArchiveCollapsed);
+        connect(archiveView->selectionModel(), &QItemSelectionModel::currentChanged, this, &MainWindow::onArchiveCurrentChanged);
 
         QToolBar *tb = addToolBar("main");
+        QAction *newAct = tb->addAction(style()->standardIcon(QStyle::SP_FileIcon), "New .vfsarc");
+        connect(newAct, &QAction::triggered, this, &MainWindow::onNewArchive);
         QAction *openAct = tb->addAction(style()->standardIcon(QStyle::SP_DialogOpenButton), "Open .vfsarc");
         connect(openAct, &QAction::triggered, this, &MainWindow::onOpenArchive);
+        QAction *extractAllAct = tb->addAction(style()->standardIcon(QStyle::SP_DialogSaveButton), "Extract All");
+        connect(extractAllAct, &QAction::triggered, this, &MainWindow::onExtractAll);
+        QAction *mergeAct = tb->addAction(style()->standardIcon(QStyle::SP_FileDialogNewFolder), "Merge Archives");
+        connect(mergeAct, &QAction::triggered, this, &MainWindow::onMergeArchives);
+        QAction *optimizeAct = tb->addAction(style()->standardIcon(QStyle::SP_BrowserReload), "Optimize");
+        connect(optimizeAct, &QAction::triggered, this, &MainWindow::onOptimizeArchive);
+        QAction *testAct = tb->addAction(style()->standardIcon(QStyle::SP_DialogApplyButton), "Test Archive");
+        connect(testAct, &QAction::triggered, this, &MainWindow::onTestArchive);
+        operationActions << extractAllAct << mergeAct << optimizeAct << testAct;
 
         splitter = new QSplitter;
         splitter->addWidget(fsView);
@@ -337,7 +5793,19 @@ public:
 
         status = statusBar();
 
-        backend = new CliArchiveHandler(this);
+        // progress strip for long operations, hidden while idle
+        progressLabel = new QLabel;
+        progressBar = new QProgressBar;
+        progressBar->setMaximumWidth(200);
+        progressCancel = new QToolButton;
+        progressCancel->setIcon(style()->standardIcon(QStyle::SP_BrowserStop));
+        progressCancel->setToolTip("Cancel");
+        status->addPermanentWidget(progressLabel);
+        status->addPermanentWidget(progressBar);
+        status->addPermanentWidget(progressCancel);
+        setProgressVisible(false);
+
+        backend = createBackend();
 
         // password cache / global pool
         // per-archive cached passwords (key = absolute archive path)
@@ -350,15 +5818,155 @@ public:
 
 private slots:
     void onOpenArchive() {
-        QString file = QFileDialog::getOpenFileName(this, "Open archive", QDir::homePath(), "Virtual Archives (*.vfsarc);;ZIP Archives (*.zip);;All Files (*)");
+        QString file = QFileDialog::getOpenFileName(this, "Open archive", QDir::homePath(), "Virtual Archives (*.vfsarc);;ZIP Archives (*.zip);;Tar Archives (*.tar *.tar.gz *.tgz *.tar.zst *.tzst);;All Files (*)");
         if (file.isEmpty()) return;
-        if (!backend->openArchive(file)) {
+        // fresh handler per archive: jobs still running against the previous one keep their own reference
+        QSharedPointer<ArchiveHandler> handler = createBackend(file);
+        if (!handler->openArchive(file)) {
             QMessageBox::warning(this, "Open failed", "Could not open archive: " + file);
             return;
         }
+        switchBackend(handler);
         currentArchive = file;
+        // native containers have no zip passwords; an empty one must not trigger the prompt
+        if (VfsArchiveHandler *vfs = dynamic_cast<VfsArchiveHandler*>(handler.data())) {
+            if (vfs->isEncrypted()) unlockVfsArchiveAndLoad(vfs, file);
+            else loadArchiveEntries(backend->listEntries(), file);
+            return;
+        }
         // try password flow -> try cached then global then prompt
-        attemptPasswordAndLoadArchive(backend, file);
+        attemptPasswordAndLoadArchive(backend.data(), file);
+    }
+
+    void onNewArchive() {
+        QString file = QFileDialog::getSaveFileName(this, "New archive", QDir::homePath(), "Virtual Archives (*.vfsarc)");
+        if (file.isEmpty()) return;
+        if (!file.endsWith(".vfsarc", Qt::CaseInsensitive)) file += ".vfsarc";
+        const bool dedup = QMessageBox::question(this, "New archive",
+            "Store repeated content only once?\n\nSuited to archives holding many versions of the same files.") == QMessageBox::Yes;
+        bool ok;
+        const QString password = QInputDialog::getText(this, "New archive", "Password (leave empty for none):",
+                                                       QLineEdit::Password, QString(), &ok);
+        if (!ok) return;
+        QSharedPointer<ArchiveHandler> handler;
+        if (createEmptyVfsArchive(file, dedup, password)) handler = createBackend(file);
+        if (!handler || !handler->openArchive(file) || (!password.isEmpty() && !static_cast<VfsArchiveHandler*>(handler.data())->unlock(password))) {
+            QMessageBox::warning(this, "Create failed", "Could not create archive: " + file);
+            return;
+        }
+        if (!password.isEmpty()) passwordCache[file] = password;
+        switchBackend(handler);
+        currentArchive = file;
+        loadArchiveEntries(backend->listEntries(), file);
+    }
+
+    void onExtractAll() {
+        if (currentArchive.isEmpty()) return;
+        QString dest = QFileDialog::getExistingDirectory(this, "Extract all to", QDir::homePath());
+        if (dest.isEmpty()) return;
+        QSharedPointer<ArchiveHandler> handler = backend;
+        runArchiveOperation(JobClass::BulkExtract, "Extracting",
+            [handler, dest](ArchiveOperation *op) { return handler->extractAll(dest, op); },
+            [this, dest](bool ok, bool cancelled) {
+                if (cancelled) status->showMessage("Extraction cancelled");
+                else if (!ok) QMessageBox::warning(this, "Extract failed", "Could not extract archive to " + dest);
+                else status->showMessage("Extracted to " + dest);
+            });
+    }
+
+    void onMergeArchives() {
+        const QStringList sources = QFileDialog::getOpenFileNames(this, "Archives to merge", QDir::homePath(),
+                                                                  "Virtual Archives (*.vfsarc);;ZIP Archives (*.zip)");
+        if (sources.size() < 2) return;
+        const QStringList policies = {"Newest wins", "Keep both", "Keep first (skip later)"};
+        bool ok;
+        const QString choice = QInputDialog::getItem(this, "Merge archives", "When a name occurs in more than one archive:",
+                                                     policies, 0, false, &ok);
+        if (!ok) return;
+        const MergePolicy policy = choice == policies.at(0) ? MergePolicy::Newest
+                                 : choice == policies.at(1) ? MergePolicy::KeepBoth : MergePolicy::Skip;
+        // entries are copied as stored, so the output has the sources' format
+        const bool vfs = VfsArchiveHandler::handles(sources.first());
+        const QString suffix = vfs ? "vfsarc" : "zip";
+        QString dest = QFileDialog::getSaveFileName(this, "Merged archive", QDir::homePath(), QString("Archive (*.%1)").arg(suffix));
+        if (dest.isEmpty()) return;
+        if (QFileInfo(dest).suffix().isEmpty()) dest += '.' + suffix;
+        if (sources.contains(dest)) {
+            QMessageBox::warning(this, "Merge failed", "Choose a file other than the archives being merged");
+            return;
+        }
+        // encrypted native archives need their passwords up front, the job can't prompt
+        QMap<QString, QString> passwords;
+        for (const QString &s : sources) {
+            VfsArchive a;
+            if (!VfsArchiveHandler::handles(s) || !a.open(s) || !a.isEncrypted()) continue;
+            QString pw = passwordCache.value(s);
+            if (pw.isEmpty()) pw = QInputDialog::getText(this, "Password required", "Password for " + QFileInfo(s).fileName() + ":",
+                                                         QLineEdit::Password, QString(), &ok);
+            if (!ok) return;
+            passwords.insert(s, pw);
+        }
+        runArchiveOperation(JobClass::BulkExtract, "Merging",
+            [sources, dest, policy, passwords](ArchiveOperation *op) { return mergeArchives(sources, dest, policy, passwords, op); },
+            [this, dest](bool ok, bool cancelled) {
+                if (cancelled) status->showMessage("Merge cancelled");
+                else if (!ok) QMessageBox::warning(this, "Merge failed", "Could not merge into " + dest
+                                                   + "\n\nAll archives must be zip, or all .vfsarc with the same chunk size."
+                                                   + " An encrypted .vfsarc can only be merged into an encrypted one, so list one first.");
+                else status->showMessage("Merged into " + dest);
+            });
+    }
+
+    void onOptimizeArchive() {
+        if (currentArchive.isEmpty()) return;
+        // zip entries stay deflate so every reader can still open them; native containers use zstd
+        const bool vfs = dynamic_cast<VfsArchiveHandler*>(backend.data()) != nullptr;
+        bool ok;
+        const int level = QInputDialog::getInt(this, "Optimize archive",
+                                               vfs ? "zstd level (1-19, higher is smaller and slower):" : "Deflate level (1-9):",
+                                               vfs ? 19 : 9, 1, vfs ? 19 : 9, 1, &ok);
+        if (!ok) return;
+        QSharedPointer<ArchiveHandler> handler = backend;
+        QSharedPointer<OptimizeResult> result(new OptimizeResult);
+        runArchiveOperation(JobClass::BulkExtract, "Optimizing",
+            [handler, level, result](ArchiveOperation *op) { return handler->optimize(level, *result, op); },
+            [this, result](bool ok, bool cancelled) {
+                if (cancelled) { status->showMessage("Optimize cancelled, archive unchanged"); return; }
+                if (!ok) { QMessageBox::warning(this, "Optimize failed", "Could not optimize " + currentArchive); return; }
+                QLocale loc;
+                const double secs = qMax<qint64>(1, result->elapsedMs) / 1000.0;
+                status->showMessage(QString("Optimized: saved %1 (%2 to %3), %4 of %5 entries recompressed, %6/s")
+                                    .arg(loc.formattedDataSize(result->sizeBefore - result->sizeAfter))
+                                    .arg(loc.formattedDataSize(result->sizeBefore))
+                                    .arg(loc.formattedDataSize(result->sizeAfter))
+                                    .arg(result->recompressed).arg(result->entries)
+                                    .arg(loc.formattedDataSize(qint64(result->bytes / secs))));
+            });
+    }
+
+    void onTestArchive() {
+        if (currentArchive.isEmpty()) return;
+        QSharedPointer<ArchiveHandler> handler = backend;
+        QSharedPointer<TestResult> result(new TestResult);
+        runArchiveOperation(JobClass::BulkExtract, "Testing",
+            [handler, result](ArchiveOperation *op) { return handler->testArchive(*result, op); },
+            [this, result](bool ok, bool cancelled) {
+                if (cancelled) { status->showMessage("Test cancelled"); return; }
+                if (!ok) { QMessageBox::warning(this, "Test failed", "This archive can't be tested: " + currentArchive); return; }
+                QLocale loc;
+                const double secs = qMax<qint64>(1, result->elapsedMs) / 1000.0;
+                const QString summary = QString("%1 entries, %2 checked at %3/s")
+                    .arg(result->entries).arg(loc.formattedDataSize(result->bytes)).arg(loc.formattedDataSize(qint64(result->bytes / secs)));
+                if (result->corrupt.isEmpty() && result->unchecked.isEmpty()) {
+                    status->showMessage("Archive OK: " + summary);
+                    return;
+                }
+                QString text = summary;
+                if (!result->corrupt.isEmpty()) text += QString("\n\nCorrupt (%1):\n").arg(result->corrupt.size()) + result->corrupt.join('\n');
+                if (!result->unchecked.isEmpty()) text += QString("\n\nNot checked (%1):\n").arg(result->unchecked.size()) + result->unchecked.join('\n');
+                if (result->corrupt.isEmpty()) QMessageBox::information(this, "Test archive", text);
+                else QMessageBox::warning(this, "Test archive", text);
+            });
     }
 
     void onArchiveExpanded(const QModelIndex &idx) {
@@ -366,15 +5974,26 @@ private slots:
         if (!idx.isValid()) return;
         ArchiveItem *it = static_cast<ArchiveItem*>(idx.internalPointer());
         if (!it || it->childrenPopulated) return;
+        it->childrenPopulated = true;
 
         QString prefix = it->fullPathInArchive;
         if (!prefix.endsWith("/")) prefix += "/";
 
-        QStringList entries = backend->listEntries(prefix);
-        archiveModel->populateFromList(entries, prefix, it);
-        it->childrenPopulated = true;
-        // notify view layout changed
-        archiveModel->layoutChanged();
+        // list on the scheduler; the node is looked up again by path since the model may change meanwhile
+        QSharedPointer<ArchiveHandler> handler = backend;
+        const QString nodePath = it->fullPathInArchive;
+        scheduler.submit(JobClass::Listing, [this, handler, prefix, nodePath](const CancelToken &token) {
+            QStringList entries = handler->listEntries(prefix);
+            if (token.isCancelled()) return;
+            QMetaObject::invokeMethod(this, [this, handler, entries, prefix, nodePath]() {
+                if (handler != backend) return;
+                ArchiveItem *node = archiveModel->findNodeByPath(nodePath);
+                if (!node) return;
+                archiveModel->populateFromList(entries, prefix, node);
+                // notify view layout changed
+                archiveModel->layoutChanged();
+            }, Qt::QueuedConnection);
+        });
     }
 
     void onArchiveCollapsed(const QModelIndex &idx) {
@@ -382,6 +6001,23 @@ private slots:
         // optional: do nothing, or free children to reduce memory
     }
 
+    void onArchiveCurrentChanged(const QModelIndex &current) {
+        // warm the preview cache with the selected entry and the ones the user is likely to step to next
+        prefetcher.cancel();
+        NativeArchiveHandler *native = dynamic_cast<NativeArchiveHandler*>(backend.data());
+        if (!native || !current.isValid()) return;
+        QVector<ZipEntryInfo> batch;
+        for (int delta : {0, 1, 2, -1}) {
+            QModelIndex sib = current.sibling(current.row() + delta, 0);
+            if (!sib.isValid()) continue;
+            ArchiveItem *it = static_cast<ArchiveItem*>(sib.internalPointer());
+            if (it->type != ArchiveItem::NodeType::File || isMediaEntry(it->fullPathInArchive)) continue;
+            ZipEntryInfo info;
+            if (native->entryInfo(it->fullPathInArchive, info)) batch << info;
+        }
+        if (!batch.isEmpty()) prefetcher.prefetch(native->archivePath(), batch);
+    }
+
     void onArchiveDoubleClicked(const QModelIndex &idx) {
         if (!idx.isValid()) return;
         ArchiveItem *it = static_cast<ArchiveItem*>(idx.internalPointer());
@@ -397,26 +6033,37 @@ private slots:
                 }
             }
             // open nested by switching backend to nested temporary archive
-            CliArchiveHandler *nested = new CliArchiveHandler(this);
+            QSharedPointer<ArchiveHandler> nested = createBackend(tmp);
             if (nested->openArchive(tmp)) {
                 // push current archive into stack for nested path tracking
                 archiveStack << QFileInfo(currentArchive).fileName() + ":" + entry;
                 updateStatusBar();
                 // switch backend to nested
-                delete backend;
-                backend = nested;
+                switchBackend(nested);
                 currentArchive = tmp;
                 archiveModel->clear();
                 archiveModel->populateFromList(backend->listEntries());
-                auto meta = loadMetadata(backend);
+                auto meta = loadMetadata(backend.data());
                 metadataView->setPlainText(QString("Nested Version: %1\nCreated: %2\nTags: %3")
                                            .arg(meta.version).arg(meta.created).arg(meta.tags.join(", ")));
             }
             return;
         }
-        // else file: preview
-        QString tmpPath;
-        if (backend->extractEntryToTemp(entry, tmpPath)) previewFile(tmpPath);
+        // else file: audio/video plays straight from the archive when the backend can stream it
+        if (isMediaEntry(entry)) {
+            if (QIODevice *dev = backend->openEntryDevice(entry)) { previewMedia(entry, dev); return; }
+        }
+        // otherwise preview from the prefetch cache, or extract as an interactive job
+        ZipEntryInfo info;
+        NativeArchiveHandler *native = dynamic_cast<NativeArchiveHandler*>(backend.data());
+        QString tmpPath = native && native->entryInfo(entry, info) ? prefetcher.cachedPath(backend->archivePath(), info) : QString();
+        if (!tmpPath.isEmpty()) { previewFile(tmpPath); return; }
+        QSharedPointer<ArchiveHandler> handler = backend;
+        scheduler.submit(JobClass::InteractivePreview, [this, handler, entry](const CancelToken &token) {
+            QString path;
+            if (!handler->extractEntryToTemp(entry, path) || token.isCancelled()) return;
+            QMetaObject::invokeMethod(this, [this, path]() { previewFile(path); }, Qt::QueuedConnection);
+        });
     }
 
     void onArchiveContextMenu(const QPoint &pos) {
@@ -428,11 +6075,55 @@ private slots:
         QAction *addFolder = menu.addAction("Add Folder");
         QAction *removeItem = menu.addAction("Remove");
         QAction *showMeta = menu.addAction("Show Metadata");
+        QAction *extractSelected = menu.addAction("Extract Selected...");
+        QAction *exportSelected = menu.addAction("Export Selection to New Archive...");
+        for (QAction *a : {addFolder, removeItem, extractSelected, exportSelected}) a->setEnabled(!currentOperation);
 
         QAction *selected = menu.exec(archiveView->viewport()->mapToGlobal(pos));
         if (!selected) return;
 
-        if (selected == addFolder) {
+        if (selected == extractSelected) {
+            // every file under the selected rows, extracted as one batch
+            QStringList entries;
+            for (const QModelIndex &row : archiveView->selectionModel()->selectedRows())
+                collectPathsRecursively(static_cast<ArchiveItem*>(row.internalPointer()), entries);
+            entries.removeDuplicates();
+            if (entries.isEmpty()) return;
+            QString dest = QFileDialog::getExistingDirectory(this, "Extract selection to", QDir::homePath());
+            if (dest.isEmpty()) return;
+            QSharedPointer<ArchiveHandler> handler = backend;
+            runArchiveOperation(JobClass::BulkExtract, "Extracting",
+                [handler, entries, dest](ArchiveOperation *op) { return handler->extractEntries(entries, dest, op); },
+                [this, dest](bool ok, bool cancelled) {
+                    if (cancelled) status->showMessage("Extraction cancelled");
+                    else if (!ok) QMessageBox::warning(this, "Extract failed", "Could not extract selection to " + dest);
+                    else status->showMessage("Extracted selection to " + dest);
+                });
+        } else if (selected == exportSelected) {
+            // entries keep their compressed bytes, so the new archive has the same format as this one
+            QStringList entries;
+            for (const QModelIndex &row : archiveView->selectionModel()->selectedRows())
+                collectPathsRecursively(static_cast<ArchiveItem*>(row.internalPointer()), entries);
+            entries.removeDuplicates();
+            if (entries.isEmpty()) return;
+            const QString suffix = QFileInfo(backend->archivePath()).suffix();
+            QString dest = QFileDialog::getSaveFileName(this, "Export selection to", QDir::homePath(),
+                                                        QString("Archive (*.%1)").arg(suffix));
+            if (dest.isEmpty()) return;
+            if (QFileInfo(dest).suffix().isEmpty()) dest += '.' + suffix;
+            if (QFileInfo(dest).absoluteFilePath() == QFileInfo(backend->archivePath()).absoluteFilePath()) {
+                QMessageBox::warning(this, "Export failed", "Choose a file other than the open archive");
+                return;
+            }
+            QSharedPointer<ArchiveHandler> handler = backend;
+            runArchiveOperation(JobClass::BulkExtract, "Exporting",
+                [handler, entries, dest](ArchiveOperation *op) { return handler->exportEntries(entries, dest, op); },
+                [this, dest](bool ok, bool cancelled) {
+                    if (cancelled) status->showMessage("Export cancelled");
+                    else if (!ok) QMessageBox::warning(this, "Export failed", "Could not export selection to " + dest);
+                    else status->showMessage("Exported selection to " + dest);
+                });
+        } else if (selected == addFolder) {
             bool ok;
             QString name = QInputDialog::getText(this, "New Folder", "Folder Name:", QLineEdit::Normal, QString(), &ok);
             if (ok && !name.isEmpty()) {
@@ -446,6 +6137,12 @@ private slots:
                 it->childrenPopulated = true;
                 archiveModel->layoutChanged();
 
+                if (VfsArchiveHandler *vfs = dynamic_cast<VfsArchiveHandler*>(backend.data())) {
+                    if (vfs->addDirectory(newFolder->fullPathInArchive)) status->showMessage("Added folder");
+                    else QMessageBox::warning(this, "Add failed", "Could not add folder to archive");
+                    maybeCompact();
+                    return;
+                }
                 // create placeholder file in archive to represent the folder (zip has no empty dir support)
                 QTemporaryFile tmp;
                 tmp.open();
@@ -464,18 +6161,28 @@ private slots:
             // collect all paths under this node
             QStringList toRemove;
             collectPathsRecursively(it, toRemove);
-            // call backend remove
-            bool ok = backend->removeEntries(toRemove);
-            if (!ok) {
-                QMessageBox::warning(this, "Remove failed", "Backend failed to remove entries (CLI may rebuild archive).");
-            } else {
-                // remove nodes in model
-                ArchiveItem *parent = it->parent;
-                if (parent) parent->children.removeOne(it);
-                delete it;
-                archiveModel->layoutChanged();
-                status->showMessage("Removed selected entry/entries");
-            }
+            // call backend remove; it rewrites the archive, so it runs as a cancellable bulk job
+            QSharedPointer<ArchiveHandler> handler = backend;
+            const QString nodePath = it->fullPathInArchive;
+            runArchiveOperation(JobClass::BulkExtract, "Removing",
+                [handler, toRemove](ArchiveOperation *op) { return handler->removeEntries(toRemove, op); },
+                [this, handler, nodePath](bool ok, bool cancelled) {
+                    if (cancelled) { status->showMessage("Remove cancelled, archive unchanged"); return; }
+                    if (!ok) {
+                        QMessageBox::warning(this, "Remove failed", "Backend failed to remove entries (CLI may rebuild archive).");
+                        return;
+                    }
+                    // remove nodes in model
+                    ArchiveItem *node = handler == backend ? archiveModel->findNodeByPath(nodePath) : nullptr;
+                    if (node) {
+                        ArchiveItem *parent = node->parent;
+                        if (parent) parent->children.removeOne(node);
+                        delete node;
+                        archiveModel->layoutChanged();
+                    }
+                    status->showMessage("Removed selected entry/entries");
+                    maybeCompact();
+                });
         } else if (selected == showMeta) {
             // show metadata of current archive or entry
             QString entry = archiveModel->pathForIndex(idx);
@@ -490,6 +6197,77 @@ private slots:
     }
 
 private:
+    // handlers are shared with scheduler jobs, so they are deleted on the GUI thread once the last job lets go
+    QSharedPointer<ArchiveHandler> createBackend(const QString &path = QString()) {
+        return QSharedPointer<ArchiveHandler>(createArchiveHandler(path), &QObject::deleteLater);
+    }
+
+    // edits to a native container only append; once enough of it is dead weight it is rewritten
+    // as a background job, which gives way to anything interactive and to edits made meanwhile
+    void maybeCompact() {
+        QSharedPointer<ArchiveHandler> handler = backend;
+        VfsArchiveHandler *vfs = dynamic_cast<VfsArchiveHandler*>(handler.data());
+        if (!vfs || !vfs->wantsCompaction()) return;
+        scheduler.submit(JobClass::Background, [this, handler, vfs](const CancelToken &token) {
+            if (!vfs->compact(token)) return;
+            QMetaObject::invokeMethod(this, [this]() { status->showMessage("Archive compacted"); }, Qt::QueuedConnection);
+        });
+    }
+
+    void switchBackend(const QSharedPointer<ArchiveHandler> &handler) {
+        // work queued for the old archive is pointless now
+        prefetcher.cancel();
+        scheduler.cancelClass(JobClass::Listing);
+        backend = handler;
+    }
+
+    // runs work(op) as a scheduler job behind the status bar progress strip; done(ok, cancelled) runs on the GUI thread
+    void runArchiveOperation(JobClass cls, const QString &label, std::function<bool(ArchiveOperation*)> work,
+                             std::function<void(bool, bool)> done) {
+        if (currentOperation) {
+            status->showMessage("Another operation is still running");
+            return;
+        }
+        ArchiveOperation *op = new ArchiveOperation(this);
+        connect(op, &ArchiveOperation::progressChanged, this, [this, label](const ArchiveProgress &p) { showProgress(label, p); });
+        connect(progressCancel, &QToolButton::clicked, op, &ArchiveOperation::cancel);
+        currentOperation = op;
+        showProgress(label, ArchiveProgress());
+        setProgressVisible(true);
+        scheduler.submit(cls, [this, op, work, done](const CancelToken &token) {
+            op->linkCancelToken(token);
+            const bool ok = work(op);
+            QMetaObject::invokeMethod(this, [this, op, ok, done]() {
+                currentOperation = nullptr;
+                setProgressVisible(false);
+                done(ok, op->isCancelled());
+                op->deleteLater();
+            }, Qt::QueuedConnection);
+        });
+    }
+
+    void showProgress(const QString &label, const ArchiveProgress &p) {
+        QLocale loc;
+        QString text = QString("%1 %2/%3").arg(label).arg(p.entriesDone).arg(p.entriesTotal);
+        if (p.bytesTotal > 0) text += QString(", %1 of %2").arg(loc.formattedDataSize(p.bytesDone)).arg(loc.formattedDataSize(p.bytesTotal));
+        if (p.bytesPerSecond > 0) text += QString(", %1/s").arg(loc.formattedDataSize(qint64(p.bytesPerSecond)));
+        if (p.etaMs >= 0) {
+            const qint64 secs = p.etaMs / 1000;
+            text += QString(", ETA %1:%2").arg(secs / 60).arg(secs % 60, 2, 10, QChar('0'));
+        }
+        progressLabel->setText(text);
+        if (p.bytesTotal > 0) { progressBar->setRange(0, 1000); progressBar->setValue(int(p.bytesDone * 1000 / p.bytesTotal)); }
+        else if (p.entriesTotal > 0) { progressBar->setRange(0, p.entriesTotal); progressBar->setValue(p.entriesDone); }
+        else progressBar->setRange(0, 0);
+    }
+
+    void setProgressVisible(bool visible) {
+        progressLabel->setVisible(visible);
+        progressBar->setVisible(visible);
+        progressCancel->setVisible(visible);
+        for (QAction *a : operationActions) a->setEnabled(!visible);
+    }
+
     // helper to collect all file paths under node (full archive paths)
     void collectPathsRecursively(ArchiveItem *node, QStringList &out) {
         if (!node) return;
@@ -537,6 +6315,31 @@ private:
         QMessageBox::warning(this, "Password Failed", "Password did not work.");
 }
 
+    // encrypted native containers: the cached and session passwords first, then prompt until one fits
+    void unlockVfsArchiveAndLoad(VfsArchiveHandler *vfs, const QString &archivePath) {
+        QStringList known;
+        if (passwordCache.contains(archivePath)) known << passwordCache[archivePath];
+        known += globalPasswords;
+        for (const QString &pw : known) {
+            if (!vfs->unlock(pw)) continue;
+            passwordCache[archivePath] = pw;
+            loadArchiveEntries(vfs->listEntries(), archivePath);
+            return;
+        }
+        for (;;) {
+            bool ok;
+            QString pw = QInputDialog::getText(this, "Password Required", QString("Enter password for %1").arg(QFileInfo(archivePath).fileName()), QLineEdit::Password, QString(), &ok);
+            if (!ok) return;
+            if (vfs->unlock(pw)) {
+                passwordCache[archivePath] = pw;
+                if (!globalPasswords.contains(pw)) globalPasswords << pw;
+                loadArchiveEntries(vfs->listEntries(), archivePath);
+                return;
+            }
+            QMessageBox::warning(this, "Password Failed", "Password did not work.");
+        }
+    }
+
     // try known passwords when extracting nested entry (returns true and tmpPath if success)
     bool tryPasswordsForEntryAndExtract(const QString &entry, QString &outTmp) {
         // try per-archive password
@@ -566,17 +6369,16 @@ private:
             passwordCache[backend->archivePath()] = pw;
             if (!globalPasswords.contains(pw)) globalPasswords << pw;
             // now open nested
-            CliArchiveHandler *nested = new CliArchiveHandler(this);
+            QSharedPointer<ArchiveHandler> nested = createBackend(tmp);
             if (nested->openArchive(tmp)) {
                 // push stack and switch
                 archiveStack << QFileInfo(currentArchive).fileName() + ":" + entryInCurrent;
                 updateStatusBar();
-                delete backend;
-                backend = nested;
+                switchBackend(nested);
                 currentArchive = tmp;
                 archiveModel->clear();
                 archiveModel->populateFromList(backend->listEntries());
-                auto meta = loadMetadata(backend);
+                auto meta = loadMetadata(backend.data());
                 metadataView->setPlainText(QString("Nested Version: %1\nCreated: %2\nTags: %3")
                                            .arg(meta.version).arg(meta.created).arg(meta.tags.join(", ")));
             }
@@ -589,7 +6391,7 @@ private:
         // set UI, populate model root-level entries
         archiveModel->clear();
         archiveModel->populateFromList(entries);
-        auto meta = loadMetadata(backend);
+        auto meta = loadMetadata(backend.data());
         metadataView->setPlainText(QString("Version: %1\nCreated: %2\nTags: %3")
                                    .arg(meta.version).arg(meta.created).arg(meta.tags.join(", ")));
         // reset archive stack to just this archive
@@ -637,6 +6439,44 @@ private:
         QDesktopServices::openUrl(QUrl::fromLocalFile(path));
     }
 
+    bool isMediaEntry(const QString &entry) const {
+        QMimeDatabase db;
+        const QString name = db.mimeTypeForFile(entry, QMimeDatabase::MatchExtension).name();
+        return name.startsWith("audio/") || name.startsWith("video/");
+    }
+
+    // inline player fed from the entry device; the dock owns player and device and frees both on close
+    void previewMedia(const QString &entry, QIODevice *dev) {
+        QDockWidget *dock = new QDockWidget(QFileInfo(entry).fileName(), this);
+        dock->setAttribute(Qt::WA_DeleteOnClose);
+        QWidget *w = new QWidget;
+        QVideoWidget *video = new QVideoWidget;
+        QPushButton *playBtn = new QPushButton("Pause");
+        QSlider *seek = new QSlider(Qt::Horizontal);
+        QHBoxLayout *controls = new QHBoxLayout;
+        controls->addWidget(playBtn);
+        controls->addWidget(seek);
+        QVBoxLayout *lay = new QVBoxLayout(w);
+        lay->addWidget(video, 1);
+        lay->addLayout(controls);
+        dock->setWidget(w);
+
+        QMediaPlayer *player = new QMediaPlayer(dock);
+        dev->setParent(player);
+        player->setVideoOutput(video);
+        connect(player, &QMediaPlayer::durationChanged, seek, [seek](qint64 d) { seek->setRange(0, int(d)); });
+        connect(player, &QMediaPlayer::positionChanged, seek, [seek](qint64 p) { if (!seek->isSliderDown()) seek->setValue(int(p)); });
+        connect(seek, &QSlider::sliderMoved, player, [player](int p) { player->setPosition(p); });
+        connect(playBtn, &QPushButton::clicked, player, [player, playBtn]() {
+            if (player->state() == QMediaPlayer::PlayingState) { player->pause(); playBtn->setText("Play"); }
+            else { player->play(); playBtn->setText("Pause"); }
+        });
+        // the content url only hints the container format to the backend; data comes from dev
+        player->setMedia(QMediaContent(QUrl(QFileInfo(entry).fileName())), dev);
+        addDockWidget(Qt::BottomDockWidgetArea, dock);
+        player->play();
+    }
+
     // members
     QFileSystemModel *fsModel;
     QTreeView *fsView;
@@ -646,9 +6486,18 @@ private:
     QDockWidget *metaDock;
     QTextEdit *metadataView;
     QStatusBar *status;
+    QLabel *progressLabel;
+    QProgressBar *progressBar;
+    QToolButton *progressCancel;
+    // one foreground operation at a time: the progress strip and its Cancel button belong to it
+    ArchiveOperation *currentOperation = nullptr;
+    QList<QAction*> operationActions;   // toolbar actions that start one, disabled meanwhile
 
-    ArchiveHandler *backend;
+    // one scheduler for every job touching an archive; declared before its users so it outlives them
+    JobScheduler scheduler;
+    QSharedPointer<ArchiveHandler> backend;
     QString currentArchive;
+    EntryPrefetcher prefetcher;
 
     // password caches
     QMap<QString, QString> passwordCache;
@@ -659,8 +6508,48 @@ private:
 };
 
 // main
+// zippy test <archive>: checks every entry without a window. Encrypted .vfsarc archives take
+// their password from ZIPPY_PASSWORD. Exits 0 when all is well, 1 on corrupt entries, 2 when
+// the archive can't be tested.
+static int runTestCommand(const QString &path) {
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+    QScopedPointer<ArchiveHandler> handler(createArchiveHandler(path));
+    if (!handler->openArchive(path)) {
+        err << "cannot open " << path << endl;
+        return 2;
+    }
+    const QString password = qEnvironmentVariable("ZIPPY_PASSWORD");
+    if (VfsArchiveHandler *vfs = dynamic_cast<VfsArchiveHandler*>(handler.data())) {
+        if (vfs->isEncrypted() && !vfs->unlock(password)) {
+            err << "wrong or missing password (set ZIPPY_PASSWORD)" << endl;
+            return 2;
+        }
+    } else if (!password.isEmpty()) {
+        handler->setPassword(password);
+    }
+    TestResult result;
+    if (!handler->testArchive(result)) {
+        err << "cannot test " << path << endl;
+        return 2;
+    }
+    for (const QString &name : result.corrupt) out << "CORRUPT  " << name << endl;
+    for (const QString &name : result.unchecked) out << "SKIPPED  " << name << endl;
+    const double secs = qMax<qint64>(1, result.elapsedMs) / 1000.0;
+    out << QString("%1 entries, %2 corrupt, %3 skipped, %4 MB/s")
+               .arg(result.entries).arg(result.corrupt.size()).arg(result.unchecked.size())
+               .arg(result.bytes / secs / 1e6, 0, 'f', 1) << endl;
+    return result.corrupt.isEmpty() ? 0 : 1;
+}
+
 int main(int argc, char **argv) {
+    if (argc == 3 && qstrcmp(argv[1], "test") == 0) {
+        QCoreApplication app(argc, argv);
+        return runTestCommand(QString::fromLocal8Bit(argv[2]));
+    }
     QApplication app(argc, argv);
+    // progress reports cross from worker threads to the GUI
+    qRegisterMetaType<ArchiveProgress>("ArchiveProgress");
     MainWindow w;
     w.show();
     return app.exec();
@@ -1,4 +1,4 @@
-QT       += core gui multimedia opengl svg network
+QT       += core gui multimedia multimediawidgets opengl svg network
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
@@ -30,6 +30,16 @@ RESOURCES +=
 
 
 LIBS += -L/Users/macbook2015/Desktop/brew/lib
+LIBS += -lz
+LIBS += -lzstd
+LIBS += -lcrypto
+
+# optional io_uring engine for extraction output, pwrite is used without it
+linux:packagesExist(liburing) {
+    CONFIG += link_pkgconfig
+    PKGCONFIG += liburing
+    DEFINES += ZIPPY_HAVE_LIBURING
+}
 
 INCLUDEPATH += /Users/macbook2015/Desktop/brew/include /Users/macbook2015/Desktop/brew/lib
 